@@ -0,0 +1,1065 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Host-side benchmarks, run with "make bench".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include "vt100_print.h"
+#include "vt100_input.h"
+#include "bms_screen.h"
+#include "vt100_log.h"
+#include "vt100_snap.h"
+#include "vt100_model.h"
+#include "bms_blob.h"
+#include "vt100_mux.h"
+#include "vt100_rec.h"
+#include "vt100_tx.h"
+
+#define ESC_LOOPS 1000000UL
+#define KEY_STREAM (1UL << 20)
+#define KEY_CHUNK  4096
+#define KEY_PASSES 16
+
+#define FRAME_ROWS  27
+#define FRAME_COLS  80
+#define FRAMES      2000
+#define BASELINE    "bench_baseline.txt"
+#define BASE_SLACK  1.02    // a metric may grow 2% over its baseline
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// The stdio path as vt100_print.c used it before vt100_out existed.
+static void bench_escapes(void) {
+    FILE *f = fopen("/dev/null", "w");
+    uint8_t buf[256];
+    vt100_out_t o;
+    uint64_t t;
+    uint32_t n;
+    if (f == NULL) { perror("/dev/null"); exit(1); }
+    vt100_out_init(&o, buf, sizeof(buf), vt100_sink_null, NULL);
+
+    t = now_ns();
+    for (n = 0; n < ESC_LOOPS; n++) fprintf(f, "\x1B[%u;%uH", 1 + n % 27, 1 + n % 71);
+    printf("CUP      stdio      %6.1f ns/escape\n", (double)(now_ns() - t) / ESC_LOOPS);
+    t = now_ns();
+    for (n = 0; n < ESC_LOOPS; n++) vt100_out_csi2(&o, 1 + n % 27, 1 + n % 71, 'H');
+    printf("CUP      vt100_out  %6.1f ns/escape\n", (double)(now_ns() - t) / ESC_LOOPS);
+
+    t = now_ns();
+    for (n = 0; n < ESC_LOOPS; n++) fprintf(f, "%1u.%03u", (uint16_t)n / 1000, (uint16_t)n % 1000);
+    printf("mV->V    stdio      %6.1f ns/value\n", (double)(now_ns() - t) / ESC_LOOPS);
+    t = now_ns();
+    for (n = 0; n < ESC_LOOPS; n++) vt100_out_mv(&o, n);
+    printf("mV->V    vt100_out  %6.1f ns/value\n", (double)(now_ns() - t) / ESC_LOOPS);
+    fclose(f);
+}
+
+static uint32_t key_events;
+
+static void bench_key_cb(void *ctx, const vt100_key_event_t *ev) {
+    key_events++;
+}
+
+// Fills buf with copies of the given sequences, picked pseudo-randomly.
+static void key_stream(uint8_t *buf, const char *const *seq, uint8_t nseq) {
+    uint32_t len = 0, r = 1;
+    const char *s;
+    while (1) {
+        r = r * 1103515245 + 12345;
+        s = seq[(r >> 16) % nseq];
+        if (len + strlen(s) > KEY_STREAM) break;
+        memcpy(buf + len, s, strlen(s));
+        len += strlen(s);
+    }
+    memset(buf + len, 'x', KEY_STREAM - len);
+}
+
+static void bench_keys_run(const char *name, uint8_t *buf) {
+    vt100_parser_t p;
+    uint64_t t;
+    uint32_t n, pass;
+    vt100_parser_init(&p);
+    key_events = 0;
+    t = now_ns();
+    for (pass = 0; pass < KEY_PASSES; pass++) {
+        for (n = 0; n < KEY_STREAM; n += KEY_CHUNK) vt100_parse(&p, buf + n, KEY_CHUNK, bench_key_cb, NULL);
+    }
+    t = now_ns() - t;
+    printf("parse    %-9s  %6.1f MB/s, %5.1f ns/event\n", name,
+           (double)KEY_STREAM * KEY_PASSES / t * 1000.0, (double)t / key_events);
+}
+
+static void bench_keys(void) {
+    static const char *const keys[] = {
+        "\x1B[A", "\x1B[B", "\x1B[1;5C", "\x1B[1;2D", "\x1BOP", "\x1B[15~", "\x1B[24;5~", "\x1B[5~", "\r", "\t"
+    };
+    static const char *const text[] = { "a", "b", "1", " ", "Z", "\x01", "\x1Bx" };
+    static const char *const paste[] = { "\x1B[200~the quick brown fox jumps over the lazy dog\r\x1B[201~" };
+    uint8_t *buf = malloc(KEY_STREAM);
+    if (buf == NULL) { perror("malloc"); exit(1); }
+    key_stream(buf, keys, sizeof(keys) / sizeof(keys[0]));
+    bench_keys_run("keys", buf);
+    key_stream(buf, text, sizeof(text) / sizeof(text[0]));
+    bench_keys_run("typing", buf);
+    key_stream(buf, paste, 1);
+    bench_keys_run("paste", buf);
+    free(buf);
+}
+
+// Pushes into a short and the longest window, each keeps min/max/avg.
+#define SERIES_LOOPS 1000000UL
+
+static void bench_series(void) {
+    static uint16_t v[255];
+    static uint8_t qmin[255], qmax[255];
+    static const uint8_t sizes[] = { BMS_TREND_W, 255 };
+    vt100_series_t s;
+    uint32_t n, sum = 0;
+    uint64_t t;
+    uint8_t k;
+    for (k = 0; k < sizeof(sizes); k++) {
+        vt100_series_init(&s, v, qmin, qmax, sizes[k]);
+        t = now_ns();
+        for (n = 0; n < SERIES_LOOPS; n++) {
+            vt100_series_push(&s, 3700 + (n * 2654435761u >> 23));
+            sum += vt100_series_min(&s) + vt100_series_max(&s) + vt100_series_avg(&s);
+        }
+        printf("series   window %-3u     %6.1f ns/sample (%u)\n", sizes[k],
+               (double)(now_ns() - t) / SERIES_LOOPS, sum & 1);
+    }
+}
+
+// A writer thread publishes snapshots whose words all hold the same count
+// as fast as it can, the reader takes them and must never see two counts.
+#define SNAP_WORDS 16
+#define SNAP_READS 2000000
+
+static uint32_t snap_data[SNAP_WORDS];
+static vt100_snap_t snap;
+static volatile bool snap_stop;
+
+static void *snap_writer(void *arg) {
+    uint32_t v[SNAP_WORDS], n = 0;
+    while (!snap_stop) {
+        n++;
+        for (uint8_t k = 0; k < SNAP_WORDS; k++) v[k] = n;
+        vt100_snap_write(&snap, v);
+    }
+    return NULL;
+}
+
+static int bench_snap(void) {
+    uint32_t v[SNAP_WORDS], torn = 0, fresh = 0, last = 0, n;
+    pthread_t writer;
+    uint64_t t;
+    vt100_snap_init(&snap, snap_data, sizeof(snap_data));
+    snap_stop = false;
+    if (pthread_create(&writer, NULL, snap_writer, NULL) != 0) return 1;
+    t = now_ns();
+    for (n = 0; n < SNAP_READS; n++) {
+        vt100_snap_read(&snap, v);
+        for (uint8_t k = 1; k < SNAP_WORDS; k++) if (v[k] != v[0]) { torn++; break; }
+        if (v[0] != last) fresh++;
+        last = v[0];
+    }
+    t = now_ns() - t;
+    snap_stop = true;
+    pthread_join(writer, NULL);
+    printf("snap     %u B under a writer  %6.1f ns/read, %u of %u new, %u torn\n",
+           (unsigned)sizeof(snap_data), (double)t / SNAP_READS, fresh, SNAP_READS, torn);
+    return torn ? 1 : 0;
+}
+
+// Render suite: every case draws frame 0 from a cleared screen and then
+// FRAMES updates into a memory sink that counts what would go on the wire.
+
+typedef struct {
+    uint32_t bytes;
+    uint32_t escapes;
+    uint32_t writes;
+} mem_sink_t;
+
+static void mem_sink(void *ctx, const uint8_t *data, uint16_t len) {
+    mem_sink_t *m = ctx;
+    m->writes++;
+    m->bytes += len;
+    for (uint16_t n = 0; n < len; n++) if (data[n] == 0x1B) m->escapes++;
+}
+
+typedef struct {
+    const char *name;
+    bool shadow;
+    uint8_t caps;
+    void (*frame)(vt100_instance_t *vt, uint32_t n);
+    uint32_t bps;       // link speed in bytes, frames are 1/10 s apart
+    bool framed;        // vt100_frame_begin/end around every frame
+} render_case_t;
+
+typedef struct {
+    char name[32];
+    double bytes, escapes, writes, ns;
+} render_result_t;
+
+static uint32_t lcg = 1;
+
+static uint32_t bench_rand(void) {
+    lcg = lcg * 1103515245 + 12345;
+    return lcg >> 16;
+}
+
+// Right-aligned in w columns, so shorter values overwrite longer ones.
+static void print_num(vt100_instance_t *vt, uint8_t x, uint8_t y, uint32_t v, uint8_t w) {
+    char num[VT100_NUM_MAX], buf[VT100_NUM_MAX + FRAME_COLS];
+    uint8_t n = vt100_utoa(num, v);
+    if (n > w) w = n;
+    memset(buf, ' ', w - n);
+    memcpy(buf + w - n, num, n + 1);
+    vt->x1 = x; vt->y1 = y; vt100_print_text(vt, buf);
+}
+
+static uint16_t bms_mv[CEL_COUNT];
+static uint16_t bms_hist_v[BMS_TREND_W];
+static uint8_t bms_hist_min[BMS_TREND_W], bms_hist_max[BMS_TREND_W];
+static vt100_series_t bms_hist;
+
+// One frame per sample, the trend follows cell 1.
+static void frame_bms(vt100_instance_t *vt, uint32_t n) {
+    if (n == 0) {
+        for (uint8_t i = 0; i < CEL_COUNT; i++) bms_mv[i] = 3750 + bench_rand() % 250;
+        vt100_series_init(&bms_hist, bms_hist_v, bms_hist_min, bms_hist_max, BMS_TREND_W);
+        bms_hist.lo = BMS_TREND_LO;
+        bms_hist.hi = BMS_TREND_HI;
+        Print_Background(vt);
+    }
+    for (uint8_t i = 0; i < CEL_COUNT; i++) bms_mv[i] += bench_rand() % 21 - 10;
+    vt100_series_push(&bms_hist, bms_mv[0]);
+    Print_Trend(vt, &bms_hist, 0);
+    Print_Values(vt, bms_mv, n / 10);
+}
+
+// 8 columns by 20 rows of numbers, all of them change every frame.
+static void frame_table(vt100_instance_t *vt, uint32_t n) {
+    if (n == 0) {
+        vt->x1 = 1; vt->y1 = 1; vt->x2 = 24; vt->y2 = 80; vt100_draw_box(vt);
+        vt->x1 = 3; vt->y1 = 1; vt->x2 = 3; vt->y2 = 80; vt100_draw_divider(vt, Horizontal, true);
+        for (uint8_t c = 1; c < 8; c++) {
+            vt->x1 = 3; vt->y1 = 1 + c * 10; vt->x2 = 24; vt->y2 = 1 + c * 10;
+            vt100_draw_divider(vt, Vertical, true);
+        }
+        for (uint8_t c = 0; c < 8; c++) print_num(vt, 2, 3 + c * 10, c + 1, 7);
+    }
+    for (uint8_t r = 0; r < 20; r++)
+        for (uint8_t c = 0; c < 8; c++) print_num(vt, 4 + r, 3 + c * 10, bench_rand() % 100000, 7);
+    vt100_flush(vt);
+}
+
+// 24 labelled boxes redrawn every frame, one counter changes per frame.
+static void frame_boxes(vt100_instance_t *vt, uint32_t n) {
+    static uint32_t count[24];
+    if (n == 0) memset(count, 0, sizeof(count));
+    for (uint8_t b = 0; b < 24; b++) {
+        uint8_t x = 1 + (b / 4) * 4, y = 1 + (b % 4) * 20;
+        vt->x1 = x; vt->y1 = y; vt->x2 = x + 3; vt->y2 = y + 19; vt100_draw_box(vt);
+        vt->x1 = x + 1; vt->y1 = y + 2; vt100_print_text(vt, "Box");
+        print_num(vt, x + 1, y + 6, b + 1, 2);
+        if (b == n % 24) count[b]++;
+        print_num(vt, x + 2, y + 2, count[b], 10);
+    }
+    vt100_flush(vt);
+}
+
+// 22 rows of 10 numbers without any frame, about one in ten changes.
+static void frame_dense(vt100_instance_t *vt, uint32_t n) {
+    static uint16_t v[22][10];
+    for (uint8_t r = 0; r < 22; r++)
+        for (uint8_t c = 0; c < 10; c++) {
+            if (n == 0 || bench_rand() % 10 == 0) v[r][c] = bench_rand() % 10000;
+            print_num(vt, 1 + r, 1 + c * 8, v[r][c], 6);
+        }
+    vt100_flush(vt);
+}
+
+// An event log of 8 lines in a box, one line comes in per frame. log lets
+// the terminal scroll, log_redraw repaints the panel like before.
+#define LOG_X1 16
+#define LOG_X2 23
+#define LOG_H  (LOG_X2 - LOG_X1 + 1)
+
+static char log_buf[VT100_LOG_BUF(32, 2, 79)];
+static vt100_log_t bench_log;
+
+static void log_text(char *buf, uint32_t n) {
+    uint16_t cell = n % CEL_COUNT + 1, mv = 3600 + n * 37 % 600;
+    sprintf(buf, "%06u  cell %2u at %4u mV%s", n, cell, mv, mv < 3700 ? ", low" : "");
+}
+
+static void log_begin(vt100_instance_t *vt) {
+    vt->x1 = 1; vt->y1 = 1; vt->x2 = 24; vt->y2 = 80; vt100_draw_box(vt);
+    vt->x1 = 2; vt->y1 = 3; vt100_print_text(vt, "Events");
+    vt->x1 = LOG_X1 - 1; vt->y1 = 1; vt->x2 = LOG_X1 - 1; vt->y2 = 80; vt100_draw_divider(vt, Horizontal, true);
+}
+
+static void frame_log(vt100_instance_t *vt, uint32_t n) {
+    char line[FRAME_COLS];
+    if (n == 0) {
+        vt100_log_init(&bench_log, log_buf, 32, LOG_X1, 2, LOG_X2, 79);
+        log_begin(vt);
+    }
+    log_text(line, n);
+    vt100_log_add(&bench_log, vt, line);
+    vt100_flush(vt);
+}
+
+static void frame_log_redraw(vt100_instance_t *vt, uint32_t n) {
+    char line[FRAME_COLS];
+    if (n == 0) log_begin(vt);
+    for (uint8_t x = LOG_X1; x <= LOG_X2; x++) {
+        uint32_t age = LOG_X2 - x;
+        if (age > n) continue;
+        log_text(line, n - age);
+        memset(line + strlen(line), ' ', 78 - strlen(line));
+        line[78] = 0;
+        vt->x1 = x; vt->y1 = 2; vt100_print_text(vt, line);
+    }
+    vt100_flush(vt);
+}
+
+static const render_case_t render_cases[] = {
+    { "bms",        true,  0,                                   frame_bms,        0, false },
+    { "bms_direct", false, 0,                                   frame_bms,        0, false },
+    { "bms_dec",    true,  VT100_CAP_DEC_LINES | VT100_CAP_REP, frame_bms,        0, false },
+    { "bms_9600",   true,  0,                                   frame_bms,        960, false },
+    { "table",      true,  0,                                   frame_table,      0, false },
+    { "boxes",      true,  0,                                   frame_boxes,      0, false },
+    { "boxes_dec",  true,  VT100_CAP_DEC_LINES | VT100_CAP_REP, frame_boxes,      0, false },
+    { "dense",      true,  0,                                   frame_dense,      0, false },
+    { "bms_frame",  true,  VT100_CAP_SYNC,                      frame_bms,        0, true },
+    { "table_frame", true, 0,                                   frame_table,      0, true },
+    { "log",        true,  0,                                   frame_log,        0, false },
+    { "log_redraw", true,  0,                                   frame_log_redraw, 0, false },
+};
+
+#define RENDER_CASES (sizeof(render_cases) / sizeof(render_cases[0]))
+
+static vt100_cell_t frame_front[FRAME_ROWS * FRAME_COLS];
+static vt100_cell_t frame_back[FRAME_ROWS * FRAME_COLS];
+
+static void render_setup(const render_case_t *rc, vt100_instance_t *vt) {
+    vt->caps = rc->caps;
+    if (rc->shadow) vt100_shadow(vt, frame_front, frame_back, FRAME_ROWS, FRAME_COLS);
+    if (rc->frame == frame_bms) vt100_regions(vt, bms_regions, BMS_REGION_COUNT);
+    vt100_link(vt, rc->bps, 10);
+}
+
+// Unframed cases write through a 256 byte buffer, framed ones hold a
+// whole frame. Every sink call stands for one write() to a terminal.
+static uint8_t render_buf[8192];
+
+static void render_out(const render_case_t *rc, vt100_instance_t *vt, vt100_sink_t sink, void *ctx) {
+    vt100_out_init(&vt->out, render_buf, rc->framed ? sizeof(render_buf) : 256, sink, ctx);
+}
+
+static void render_frame(const render_case_t *rc, vt100_instance_t *vt, uint32_t n) {
+    if (rc->framed) vt100_frame_begin(vt);
+    rc->frame(vt, n);
+    if (rc->framed) vt100_frame_end(vt);
+    vt100_out_flush(&vt->out);
+}
+
+static void render_run(const render_case_t *rc, render_result_t *first, render_result_t *update) {
+    vt100_instance_t vt;
+    mem_sink_t m = { 0 };
+    uint64_t t;
+    uint32_t n;
+
+    lcg = 1;
+    vt100_init(&vt);
+    render_out(rc, &vt, mem_sink, &m);
+    render_setup(rc, &vt);
+
+    t = now_ns();
+    vt100_begin(&vt);
+    render_frame(rc, &vt, 0);
+    first->ns = now_ns() - t;
+    first->bytes = m.bytes; first->escapes = m.escapes; first->writes = m.writes;
+    snprintf(first->name, sizeof(first->name), "%s/first", rc->name);
+
+    memset(&m, 0, sizeof(m));
+    t = now_ns();
+    for (n = 1; n <= FRAMES; n++) render_frame(rc, &vt, n);
+    update->ns = (double)(now_ns() - t) / FRAMES;
+    update->bytes = (double)m.bytes / FRAMES;
+    update->escapes = (double)m.escapes / FRAMES;
+    update->writes = (double)m.writes / FRAMES;
+    snprintf(update->name, sizeof(update->name), "%s/update", rc->name);
+}
+
+// Renders the case again into the terminal model. A shadow front has to
+// match what the terminal shows, and every case drawing the same frames
+// has to end on the screen the first of them produced.
+static vt100_model_t models[RENDER_CASES];
+static vt100_cell_t model_cells[RENDER_CASES][FRAME_ROWS * FRAME_COLS];
+
+static bool render_check(const vt100_model_t *m, const vt100_cell_t *grid, const char *what) {
+    uint16_t d, first = 0;
+    const vt100_cell_t *a, *b;
+    if ((d = vt100_model_diff(m, grid, &first)) == 0) return true;
+    a = &m->cells[first]; b = &grid[first];
+    printf("         %u cells differ from %s, first at %u;%u: U+%04X %u/%u/%02X, expected U+%04X %u/%u/%02X\n",
+           d, what, first / m->cols + 1, first % m->cols + 1,
+           a->ch, a->a.fg, a->a.bg, a->a.modes, b->ch, b->a.fg, b->a.bg, b->a.modes);
+    return false;
+}
+
+static int render_verify(uint8_t c) {
+    const render_case_t *rc = &render_cases[c];
+    vt100_model_t *m = &models[c];
+    vt100_instance_t vt;
+    uint8_t k;
+    uint32_t n, framed, over = 0;
+    bool ok = true;
+
+    lcg = 1;
+    vt100_init(&vt);
+    vt100_model_init(m, model_cells[c], FRAME_ROWS, FRAME_COLS);
+    render_out(rc, &vt, vt100_model_sink, m);
+    render_setup(rc, &vt);
+    vt100_begin(&vt);
+    framed = vt.out.bytes;
+    for (n = 0; n <= FRAMES; n++) {
+        vt100_stats_begin(&vt, 0);
+        render_frame(rc, &vt, n);
+        vt100_stats_end(&vt, 0);
+        framed += vt.stats.bytes;
+        if (vt.budget && vt.stats.bytes > vt.budget) over++;
+    }
+    if (over) {
+        printf("model    %s: %u frames over the %u B link budget\n", rc->name, over, vt.budget);
+        ok = false;
+    }
+    if (framed != m->bytes || vt.out.bytes != m->bytes) {
+        printf("model    %s: the counters say %u B with frames, %u B in all, the terminal got %u B\n",
+               rc->name, framed, vt.out.bytes, m->bytes);
+        ok = false;
+    }
+    while (vt.behind) vt100_flush(&vt);     // a budgeted link catches up when idle
+
+    printf("model    %-17s %8u B, %6.2f%% without visible change, %u unknown\n", rc->name,
+           m->bytes, 100.0 * m->wasted / m->bytes, m->unknown);
+    if (rc->shadow) ok &= render_check(m, frame_front, "the shadow front");
+    for (k = 0; k < c; k++) {
+        if (render_cases[k].frame != rc->frame) continue;
+        ok &= render_check(m, model_cells[k], render_cases[k].name);
+        break;
+    }
+    ok &= m->unknown == 0;
+    if (!ok) printf("model    %s renders a different screen\n", rc->name);
+    return ok ? 0 : 1;
+}
+
+// Only the wire metrics are checked, ns depend on the machine.
+static bool render_worse(double now, double base) {
+    return now > base * BASE_SLACK + 0.05;
+}
+
+static int bench_render(bool update_baseline) {
+    render_result_t res[RENDER_CASES * 2], b;
+    char line[128];
+    FILE *f;
+    uint8_t n, k;
+    int failed = 0;
+
+    for (n = 0; n < RENDER_CASES; n++) render_run(&render_cases[n], &res[2 * n], &res[2 * n + 1]);
+
+    f = fopen(BASELINE, "r");
+    for (n = 0; n < RENDER_CASES * 2; n++) {
+        const char *verdict = "new";
+        if (f != NULL) {
+            rewind(f);
+            while (fgets(line, sizeof(line), f) != NULL) {
+                if (sscanf(line, "%31s %lf %lf %lf", b.name, &b.bytes, &b.escapes, &b.writes) != 4) continue;
+                if (strcmp(b.name, res[n].name)) continue;
+                k = render_worse(res[n].bytes, b.bytes) || render_worse(res[n].escapes, b.escapes) ||
+                    render_worse(res[n].writes, b.writes);
+                verdict = k ? "WORSE" : "ok";
+                failed += k;
+                break;
+            }
+        }
+        printf("render   %-17s %8.1f B %7.1f esc %5.1f wr %9.0f ns/frame  %s\n", res[n].name,
+               res[n].bytes, res[n].escapes, res[n].writes, res[n].ns, verdict);
+        if (!strcmp(verdict, "WORSE"))
+            printf("         baseline          %8.1f B %7.1f esc %5.1f wr\n", b.bytes, b.escapes, b.writes);
+    }
+    if (f != NULL) fclose(f);
+
+    for (n = 0; n < RENDER_CASES; n++) failed += render_verify(n);
+
+    if (update_baseline) {
+        f = fopen(BASELINE, "w");
+        if (f == NULL) { perror(BASELINE); exit(1); }
+        fprintf(f, "# case bytes/frame escapes/frame writes/frame, written by vt100_bench -u\n");
+        for (n = 0; n < RENDER_CASES * 2; n++)
+            fprintf(f, "%s %.1f %.1f %.1f\n", res[n].name, res[n].bytes, res[n].escapes, res[n].writes);
+        fclose(f);
+        printf("render   baseline written to " BASELINE "\n");
+        return 0;
+    }
+    if (failed) printf("render   %d check(s) failed\n", failed);
+    return failed ? 1 : 0;
+}
+
+// Cold start of the BMS screen through the library and from the blob.
+// Both have to leave the same screen, and the blob one a matching front.
+#define BLOB_LOOPS 1000
+
+static void blob_start(vt100_instance_t *vt, const uint8_t *blob, uint16_t len) {
+    vt100_shadow(vt, frame_front, frame_back, BMS_ROWS, BMS_COLS);
+    if (blob == NULL) {
+        vt100_begin(vt);
+        Print_Background(vt);
+        vt100_flush(vt);
+        return;
+    }
+    Print_Background(vt);
+    vt100_commit(vt);
+    vt100_out_data_P(&vt->out, blob, len);
+}
+
+static int bench_blob_run(const char *name, uint8_t caps, const uint8_t *blob, uint16_t len, vt100_cell_t *screen) {
+    static vt100_cell_t cells[BMS_ROWS * BMS_COLS];
+    vt100_instance_t vt;
+    vt100_model_t m;
+    uint8_t buf[256];
+    mem_sink_t ms = { 0 };
+    uint64_t t;
+    uint32_t n;
+    uint16_t v[CEL_COUNT];
+    bool ok;
+
+    vt100_init(&vt);
+    vt.caps = caps;
+    vt100_out_init(&vt.out, buf, sizeof(buf), mem_sink, &ms);
+    t = now_ns();
+    for (n = 0; n < BLOB_LOOPS; n++) blob_start(&vt, blob, len);
+    t = now_ns() - t;
+    printf("start    %-17s %8.1f B %7.1f esc %5.1f wr %9.0f ns\n", name, (double)ms.bytes / BLOB_LOOPS,
+           (double)ms.escapes / BLOB_LOOPS, (double)ms.writes / BLOB_LOOPS, (double)t / BLOB_LOOPS);
+
+    // One frame of values on top shows whether front was right
+    for (n = 0; n < CEL_COUNT; n++) v[n] = 3700 + n * 17;
+    vt100_model_init(&m, cells, BMS_ROWS, BMS_COLS);
+    vt100_out_init(&vt.out, buf, sizeof(buf), vt100_model_sink, &m);
+    blob_start(&vt, blob, len);
+    Print_Values(&vt, v, 3723);
+    ok = render_check(&m, frame_front, "the shadow front") && m.unknown == 0;
+    if (blob) ok &= render_check(&m, screen, "the library start");
+    else memcpy(screen, cells, sizeof(cells));
+    if (!ok) printf("start    %s renders a different screen\n", name);
+    return ok ? 0 : 1;
+}
+
+static int bench_blob(void) {
+    static vt100_cell_t plain[BMS_ROWS * BMS_COLS], dec[BMS_ROWS * BMS_COLS];
+    int failed = 0;
+    failed += bench_blob_run("library", BMS_BLOB_PLAIN_CAPS, NULL, 0, plain);
+    failed += bench_blob_run("blob", BMS_BLOB_PLAIN_CAPS, bms_blob_plain, BMS_BLOB_PLAIN_LEN, plain);
+    failed += bench_blob_run("library_dec", BMS_BLOB_DEC_CAPS, NULL, 0, dec);
+    failed += bench_blob_run("blob_dec", BMS_BLOB_DEC_CAPS, bms_blob_dec, BMS_BLOB_DEC_LEN, dec);
+    return failed;
+}
+
+// 100 terminals on socketpairs watch one BMS screen. Every tenth reads
+// only every MUX_SLOW frames, the others read each frame. At the end all
+// of them have to show the owner's back grid.
+#define MUX_CLIENTS 100
+#define MUX_FRAMES  1000
+#define MUX_SLOW    25
+#define MUX_SNDBUF  4096
+
+static int mux_fd[MUX_CLIENTS];
+static vt100_model_t mux_model[MUX_CLIENTS];
+static vt100_cell_t mux_cells[MUX_CLIENTS][BMS_ROWS * BMS_COLS];
+
+static void mux_read(uint8_t k) {
+    static uint8_t buf[65536];
+    ssize_t n;
+    while ((n = read(mux_fd[k], buf, sizeof(buf))) > 0) vt100_model_feed(&mux_model[k], buf, n);
+}
+
+static int bench_mux(void) {
+    vt100_instance_t owner;
+    vt100_mux_t mux;
+    vt100_mux_client_t *c;
+    uint8_t buf[256];
+    int sv[2], size = MUX_SNDBUF, failed = 0;
+    uint32_t n, k, slow_bytes = 0, fast_bytes = 0, skipped = 0, repaints = 0;
+    uint64_t t, busy = 0;
+    struct rusage r0, r1;
+    double cpu;
+
+    lcg = 1;
+    vt100_init(&owner);
+    vt100_out_init(&owner.out, buf, sizeof(buf), vt100_sink_null, NULL);
+    vt100_shadow(&owner, NULL, frame_back, BMS_ROWS, BMS_COLS);
+    vt100_regions(&owner, bms_regions, BMS_REGION_COUNT);
+    if (!vt100_mux_init(&mux, &owner, MUX_CLIENTS, 0)) { perror("vt100_mux_init"); exit(1); }
+    for (k = 0; k < MUX_CLIENTS; k++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) { perror("socketpair"); exit(1); }
+        setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        fcntl(sv[1], F_SETFL, O_NONBLOCK);
+        mux_fd[k] = sv[1];
+        vt100_model_init(&mux_model[k], mux_cells[k], BMS_ROWS, BMS_COLS);
+        if (vt100_mux_add(&mux, sv[0]) == NULL) { perror("vt100_mux_add"); exit(1); }
+    }
+
+    getrusage(RUSAGE_SELF, &r0);
+    for (n = 0; n < MUX_FRAMES; n++) {
+        frame_bms(&owner, n);
+        t = now_ns();
+        vt100_mux_flush(&mux);
+        busy += now_ns() - t;
+        for (k = 0; k < MUX_CLIENTS; k++) {
+            if (k % 10 != 9 || n % MUX_SLOW == 0) mux_read(k);
+        }
+    }
+    getrusage(RUSAGE_SELF, &r1);
+    cpu = (r1.ru_utime.tv_sec - r0.ru_utime.tv_sec + r1.ru_stime.tv_sec - r0.ru_stime.tv_sec) * 1e6 +
+          (r1.ru_utime.tv_usec - r0.ru_utime.tv_usec + r1.ru_stime.tv_usec - r0.ru_stime.tv_usec);
+
+    for (k = 0; k < MUX_CLIENTS; k++) {
+        c = &mux.client[k];
+        if (k % 10 == 9) slow_bytes += c->sent; else fast_bytes += c->sent;
+        skipped += c->skipped;
+        repaints += c->repaints;
+    }
+    printf("mux      %u clients       %6.1f us/frame in vt100_mux_flush, %6.1f us/frame cpu with readers\n",
+           MUX_CLIENTS, busy / 1000.0 / MUX_FRAMES, cpu / MUX_FRAMES);
+    printf("mux      fast client      %6.1f B/frame\n", (double)fast_bytes / (MUX_CLIENTS * 9 / 10) / MUX_FRAMES);
+    printf("mux      slow client      %6.1f B/frame, %u frames skipped, %u repaints for %u clients\n",
+           (double)slow_bytes / (MUX_CLIENTS / 10) / MUX_FRAMES, skipped, repaints, MUX_CLIENTS);
+
+    // Let everybody catch up, then compare
+    for (n = 0; n < 100 && (n == 0 || vt100_mux_busy(&mux)); n++) {
+        vt100_mux_flush(&mux);
+        for (k = 0; k < MUX_CLIENTS; k++) mux_read(k);
+    }
+    for (k = 0; k < MUX_CLIENTS; k++) {
+        if (render_check(&mux_model[k], frame_back, "the shared screen")) continue;
+        printf("mux      client %u shows a different screen\n", k);
+        failed = 1;
+    }
+    if (repaints != MUX_CLIENTS) {
+        printf("mux      slow clients forced %u extra repaints\n", repaints - MUX_CLIENTS);
+        failed = 1;
+    }
+    vt100_mux_close(&mux);
+    for (k = 0; k < MUX_CLIENTS; k++) close(mux_fd[k]);
+    return failed;
+}
+
+// The bms case again with popups over it: help opens on frame 5 of every
+// 20, the counters on frame 8 partly over it, help closes below them on
+// 12 and the counters on 15. Nothing drawn underneath may show through,
+// and the screen has to end as the plain case did.
+#define POPUP_X1 10
+#define POPUP_Y1 20
+#define POPUP_X2 17
+#define POPUP_Y2 49
+
+static bool popup_rect_eq(const vt100_cell_t *a, const vt100_cell_t *b) {
+    const vt100_box_t *h = &bms_box[BMS_BOX_HELP];
+    for (uint8_t x = h->x1; x <= h->x2; x++)
+        for (uint8_t y = h->y1; y <= h->y2; y++) {
+            uint16_t k = (x - 1) * FRAME_COLS + y - 1;
+            if (a[k].ch != b[k].ch || memcmp(&a[k].a, &b[k].a, sizeof(a[k].a))) return false;
+        }
+    return true;
+}
+
+static int bench_popup(void) {
+    static vt100_cell_t cells[FRAME_ROWS * FRAME_COLS], help_shown[FRAME_ROWS * FRAME_COLS];
+    static vt100_cell_t help_save[VT100_WIN_CELLS(1, 1, BMS_HELP_ROWS, BMS_HELP_COLS)];
+    static vt100_cell_t stats_save[VT100_WIN_CELLS(POPUP_X1, POPUP_Y1, POPUP_X2, POPUP_Y2)];
+    vt100_instance_t vt;
+    vt100_win_t help, stats, edge;
+    vt100_model_t m;
+    uint8_t buf[256];
+    uint32_t n, at, open_b = 0, close_b = 0, frame_b = 0, first = 0, frames = 0, through = 0;
+    bool ok, edge_open;
+
+    lcg = 1;
+    vt100_init(&vt);
+    vt100_model_init(&m, cells, FRAME_ROWS, FRAME_COLS);
+    vt100_out_init(&vt.out, buf, sizeof(buf), vt100_model_sink, &m);
+    render_setup(&render_cases[0], &vt);
+    vt100_begin(&vt);
+    for (n = 0; n <= FRAMES; n++) {
+        at = m.bytes;
+        frame_bms(&vt, n);
+        if (n % 20 == 5) {
+            Bms_Box(&vt, BMS_BOX_HELP);
+            vt100_win_open(&vt, &help, help_save);
+            Print_Help(&vt);
+            vt100_win_select(&vt, NULL);
+        }
+        if (n % 20 == 8) {
+            vt.x1 = POPUP_X1; vt.y1 = POPUP_Y1; vt.x2 = POPUP_X2; vt.y2 = POPUP_Y2;
+            vt100_win_open(&vt, &stats, stats_save);
+        }
+        if (n % 20 >= 8 && n % 20 < 15) {
+            vt100_win_select(&vt, &stats);
+            vt.x1 = POPUP_X1; vt.y1 = POPUP_Y1; vt.x2 = POPUP_X2; vt.y2 = POPUP_Y2;
+            vt100_draw_stats(&vt);
+            vt100_win_select(&vt, NULL);
+        }
+        if (n % 20 == 12) vt100_win_close(&vt, &help);
+        if (n % 20 == 15) vt100_win_close(&vt, &stats);
+        vt100_flush(&vt);
+        vt100_out_flush(&vt.out);
+        if (n % 20 == 5) { open_b += m.bytes - at; memcpy(help_shown, cells, sizeof(cells)); }
+        else if (n % 20 == 15) close_b += m.bytes - at;
+        else if (n == 0) first = m.bytes - at;
+        else { frame_b += m.bytes - at; frames++; }
+        if (n % 20 > 5 && n % 20 < 8 && !popup_rect_eq(cells, help_shown)) through++;
+    }
+    printf("popup    open %5.1f B, close %5.1f B, other frames %5.1f B, first %u B, %u shown through\n",
+           open_b / (FRAMES / 20.0), close_b / (FRAMES / 20.0), (double)frame_b / frames,
+           first, through);
+    ok = render_check(&m, frame_front, "the shadow front") && m.unknown == 0 && through == 0;
+    ok &= render_check(&m, model_cells[0], render_cases[0].name);
+    if (!ok) printf("popup    renders a different screen\n");
+    // Row and column 0 are off the screen
+    vt.x1 = 0; vt.y1 = POPUP_Y1; vt.x2 = POPUP_X2; vt.y2 = POPUP_Y2;
+    edge_open = vt100_win_open(&vt, &edge, stats_save);
+    vt.x1 = POPUP_X1; vt.y1 = 0;
+    edge_open |= vt100_win_open(&vt, &edge, stats_save);
+    if (edge_open) printf("popup    opened a window at row or column 0\n");
+    ok &= !edge_open && vt.top == NULL;
+    return ok ? 0 : 1;
+}
+
+// The bms case on a terminal that grows to the size its cursor report
+// gives and then shrinks back. Growing keeps the front, so the relayout
+// sends what moved; a full repaint at the new size is the comparison.
+#define RESIZE_ROWS 36
+#define RESIZE_COLS 100
+
+static void resize_cpr(void *ctx, const vt100_key_event_t *ev) {
+    vt100_key_event_t *cpr = ctx;
+    if (ev->key == KBD_BTN_CPR) *cpr = *ev;
+}
+
+static uint32_t resize_frame(vt100_instance_t *vt, vt100_model_t *m, uint8_t rows, uint8_t cols, uint32_t n) {
+    uint32_t at = m->bytes;
+    vt100_resize(vt, rows, cols);
+    vt100_model_resize(m, rows, cols);
+    Bms_Layout(rows, cols);
+    Print_Background(vt);
+    frame_bms(vt, n);
+    vt100_out_flush(&vt->out);
+    return m->bytes - at;
+}
+
+static int bench_resize(void) {
+    static vt100_cell_t front[RESIZE_ROWS * RESIZE_COLS], back[RESIZE_ROWS * RESIZE_COLS];
+    static vt100_cell_t cells[RESIZE_ROWS * RESIZE_COLS];
+    const uint8_t reply[] = "\x1B[1;5R\x1B[36;100R";
+    vt100_key_event_t cpr = { 0 };
+    vt100_parser_t kbd;
+    vt100_instance_t vt;
+    vt100_model_t m;
+    mem_sink_t ms = { 0 };
+    uint8_t buf[256];
+    uint32_t n, grow, shrink;
+    bool ok;
+
+    vt100_parser_init(&kbd);
+    vt100_parse(&kbd, reply, sizeof(reply) - 1, resize_cpr, &cpr);
+    if (cpr.x != RESIZE_ROWS || cpr.y != RESIZE_COLS) {
+        printf("resize   cursor report read as %u;%u\n", cpr.x, cpr.y);
+        return 1;
+    }
+
+    lcg = 1;
+    vt100_init(&vt);
+    vt100_model_init(&m, cells, BMS_ROWS, BMS_COLS);
+    vt100_out_init(&vt.out, buf, sizeof(buf), vt100_model_sink, &m);
+    vt100_shadow(&vt, front, back, BMS_ROWS, BMS_COLS);
+    vt100_regions(&vt, bms_regions, BMS_REGION_COUNT);
+    vt100_begin(&vt);
+    for (n = 0; n < 100; n++) {
+        frame_bms(&vt, n);
+        vt100_out_flush(&vt.out);
+    }
+    grow = resize_frame(&vt, &m, cpr.x, cpr.y, n++);
+    ok = render_check(&m, front, "the grown shadow front");
+    shrink = resize_frame(&vt, &m, BMS_ROWS, BMS_COLS, n++);
+    ok &= render_check(&m, front, "the shrunk shadow front") && m.unknown == 0;
+
+    // The same frame from a cleared terminal of the grown size
+    lcg = 1;
+    vt100_init(&vt);
+    vt100_out_init(&vt.out, buf, sizeof(buf), mem_sink, &ms);
+    vt100_shadow(&vt, front, back, RESIZE_ROWS, RESIZE_COLS);
+    Bms_Layout(RESIZE_ROWS, RESIZE_COLS);
+    vt100_begin(&vt);
+    frame_bms(&vt, 0);
+    vt100_out_flush(&vt.out);
+
+    printf("resize   %ux%u to %ux%u %6u B, repaint %u B, back %u B cleared\n", BMS_ROWS, BMS_COLS,
+           RESIZE_ROWS, RESIZE_COLS, grow, ms.bytes, shrink);
+    Bms_Layout(BMS_ROWS, BMS_COLS);
+    if (!ok) printf("resize   renders a different screen\n");
+    return ok ? 0 : 1;
+}
+
+// A Volts field in direct mode, the value walking by a few millivolts
+// like a cell does, against printing the whole value each time. A raw
+// field next to it drops from five digits to three, which has to clear.
+#define NUM_LOOPS 100000
+
+static bool num_shows(const vt100_model_t *m, uint8_t y, const char *txt) {
+    for (uint8_t k = 0; txt[k]; k++)
+        if (m->cells[y - 1 + k].ch != (uint8_t)txt[k]) return false;
+    return true;
+}
+
+static int bench_num(void) {
+    static vt100_cell_t cells[2 * FRAME_COLS];
+    vt100_instance_t vt;
+    vt100_model_t m;
+    vt100_num_t volts, raw, wide, narrow;
+    mem_sink_t ms = { 0 };
+    uint8_t buf[256];
+    char txt[VT100_NUM_MAX];
+    uint32_t n, field, full;
+    uint16_t mv = 3800;
+    bool ok;
+
+    vt100_init(&vt);
+    vt100_out_init(&vt.out, buf, sizeof(buf), mem_sink, &ms);
+    vt100_num_init(&volts, 1, 1, 6, 3, 0);
+    lcg = 1;
+    for (n = 0; n < NUM_LOOPS; n++) {
+        mv += bench_rand() % 7 - 3;
+        vt100_draw_num(&vt, &volts, mv);
+    }
+    vt100_out_flush(&vt.out);
+    field = ms.bytes;
+    ms.bytes = 0;
+    lcg = 1;
+    mv = 3800;
+    for (n = 0; n < NUM_LOOPS; n++) {
+        mv += bench_rand() % 7 - 3;
+        vt100_mvtoa(txt, mv);
+        vt.x1 = 1; vt.y1 = 2; vt100_print_text(&vt, txt);
+    }
+    vt100_out_flush(&vt.out);
+    full = ms.bytes;
+
+    vt100_init(&vt);
+    vt100_model_init(&m, cells, 2, FRAME_COLS);
+    vt100_out_init(&vt.out, buf, sizeof(buf), vt100_model_sink, &m);
+    vt100_num_init(&volts, 1, 1, 6, 3, 0);
+    vt100_num_init(&raw, 1, 10, 5, 0, VT100_NUM_LEFT);
+    vt100_num_init(&wide, 1, 20, 8, 20, 0);
+    vt100_num_init(&narrow, 1, 30, 4, 3, 0);
+    vt100_draw_num(&vt, &volts, 3854);
+    vt100_draw_num(&vt, &volts, 12345);
+    vt100_draw_num(&vt, &raw, 12345);
+    vt100_draw_num(&vt, &raw, 999);
+    vt100_draw_num(&vt, &wide, 1234567);
+    vt100_draw_num(&vt, &narrow, 3854);
+    vt100_out_flush(&vt.out);
+    ok = num_shows(&m, 1, "12.345") && num_shows(&m, 10, "999  ") &&
+         num_shows(&m, 20, "########") && num_shows(&m, 30, "####") && m.unknown == 0;
+
+    printf("num      %5.2f B/update in a field, %5.2f B printing the value\n",
+           (double)field / NUM_LOOPS, (double)full / NUM_LOOPS);
+    if (!ok) printf("num      field shows the wrong text\n");
+    return ok ? 0 : 1;
+}
+
+// The log case behind a TX ring that a slow link empties, TX_RATE bytes
+// a frame, with a ring as on a PC and the largest one an AVR can index.
+// Frames are skipped rather than waited for, and once the link catches
+// up the terminal shows what the shadow front holds.
+#define TX_RING   1024
+#define TX_RING_S 128
+#define TX_RATE   48
+#define TX_FRAMES 200
+
+static void tx_drain(vt100_tx_t *t, vt100_model_t *m, uint16_t len) {
+    uint8_t buf[TX_RATE];
+    vt100_idx_t n;
+    while (len && (n = vt100_tx_read(t, buf, len < sizeof(buf) ? len : sizeof(buf))) != 0) {
+        vt100_model_sink(m, buf, n);
+        len -= n;
+    }
+}
+
+static vt100_tx_t bench_tx_q;
+static vt100_model_t bench_tx_m;
+
+static void tx_wait(void *ctx) {
+    tx_drain(&bench_tx_q, &bench_tx_m, TX_RATE);
+}
+
+static int bench_tx_run(uint16_t size) {
+    static vt100_cell_t cells[FRAME_ROWS * FRAME_COLS];
+    static uint8_t ring[TX_RING];
+    vt100_instance_t vt;
+    uint8_t buf[256];
+    uint32_t n, drawn = 0, cut = 0;
+    bool ok;
+
+    vt100_init(&vt);
+    vt100_model_init(&bench_tx_m, cells, FRAME_ROWS, FRAME_COLS);
+    vt100_tx_init(&bench_tx_q, ring, size, NULL, tx_wait, NULL);
+    vt100_out_init(&vt.out, buf, sizeof(buf), vt100_tx_sink, &bench_tx_q);
+    vt100_shadow(&vt, frame_front, frame_back, FRAME_ROWS, FRAME_COLS);
+    vt100_begin(&vt);
+    vt100_out_flush(&vt.out);
+    for (n = 0; n < TX_FRAMES || vt.behind; n++) {
+        tx_drain(&bench_tx_q, &bench_tx_m, TX_RATE);
+        if (!vt100_tx_frame(&bench_tx_q, &vt)) continue;
+        if (n < TX_FRAMES) frame_log(&vt, drawn++);
+        else vt100_flush(&vt);
+        cut += vt.behind;
+    }
+    tx_drain(&bench_tx_q, &bench_tx_m, TX_RING);
+    ok = render_check(&bench_tx_m, frame_front, "the shadow front") && bench_tx_m.unknown == 0;
+    ok &= bench_tx_q.stalls == 0 && cut > 0;
+
+    printf("tx       %4u B ring %4u frames drawn, %u cut to the ring, %u skipped, %u stalls, up to %u B queued\n",
+           size, drawn, cut, bench_tx_q.skipped, bench_tx_q.stalls, bench_tx_q.backlog_max);
+    if (!ok) printf("tx       blocked or renders a different screen\n");
+    return ok ? 0 : 1;
+}
+
+// The link budget holds every frame the ring has room for, not only the
+// first one.
+static int bench_tx_link(void) {
+    static uint8_t ring[TX_RING];
+    vt100_instance_t vt;
+    vt100_tx_t q;
+    bool ok;
+
+    vt100_init(&vt);
+    vt100_out_init(&vt.out, NULL, 0, vt100_sink_null, NULL);
+    vt100_tx_init(&q, ring, TX_RING, NULL, NULL, NULL);
+    vt100_link(&vt, 960, 10);
+    ok = vt100_tx_frame(&q, &vt) && vt.budget == 96;
+    ok &= vt100_tx_frame(&q, &vt) && vt.budget == 96;
+    if (!ok) printf("tx       frame budget %u instead of the 96 B link\n", vt.budget);
+    return ok ? 0 : 1;
+}
+
+static int bench_tx(void) {
+    return bench_tx_run(TX_RING) | bench_tx_run(TX_RING_S) | bench_tx_link();
+}
+
+// Records the bms case with a key stream next to it and plays it back
+// from the mapping. The screen has to end as the shadow front did, and
+// every key has to come out of the decoder again.
+#define REPLAY_LOOPS 20
+
+static int bench_replay(void) {
+    char path[] = "/tmp/vt100_benchXXXXXX";
+    vt100_instance_t vt;
+    vt100_rec_t rec;
+    vt100_play_t p;
+    vt100_rec_event_t ev;
+    vt100_parser_t kbd;
+    vt100_model_t m;
+    uint8_t buf[256];
+    uint32_t n, records = 0;
+    uint64_t t, bytes = 0;
+    int fd = mkstemp(path);
+    bool ok;
+
+    if (fd < 0 || !vt100_rec_open(&rec, path, NULL, NULL)) { perror(path); return 1; }
+    close(fd);
+    lcg = 1;
+    vt100_init(&vt);
+    vt100_out_init(&vt.out, buf, sizeof(buf), vt100_rec_sink, &rec);
+    render_setup(&render_cases[0], &vt);
+    vt100_begin(&vt);
+    for (n = 0; n <= FRAMES; n++) {
+        vt100_rec_put(&rec, VT100_REC_IN, (const uint8_t *)"\x1B[Aa", 4);
+        frame_bms(&vt, n);
+        vt100_out_flush(&vt.out);
+    }
+    vt100_rec_close(&rec);
+    ok = vt100_play_open(&p, path);
+    unlink(path);
+    if (!ok) { perror(path); return 1; }
+
+    key_events = 0;
+    t = now_ns();
+    for (n = 0; n < REPLAY_LOOPS; n++) {
+        vt100_parser_init(&kbd);
+        vt100_model_init(&m, model_cells[0], FRAME_ROWS, FRAME_COLS);
+        vt100_play_rewind(&p);
+        while (vt100_play_next(&p, &ev)) {
+            if (ev.stream == VT100_REC_IN) vt100_parse(&kbd, ev.data, ev.len, bench_key_cb, NULL);
+            else vt100_model_feed(&m, ev.data, ev.len);
+            records++;
+            bytes += ev.len;
+        }
+    }
+    t = now_ns() - t;
+    vt100_play_close(&p);
+
+    printf("replay   %u records of %u B, %6.1f MB/s through decoder and model\n", records / REPLAY_LOOPS,
+           (uint32_t)(bytes / REPLAY_LOOPS), bytes * 1000.0 / t);
+    ok = render_check(&m, frame_front, "the recorded shadow front") && m.unknown == 0;
+    if (key_events != 2 * (FRAMES + 1) * REPLAY_LOOPS) {
+        printf("replay   %u keys decoded, %u recorded\n", key_events, 2 * (FRAMES + 1) * REPLAY_LOOPS);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    bool update_baseline = argc > 1 && !strcmp(argv[1], "-u");
+    Bms_Layout(BMS_ROWS, BMS_COLS);
+    bench_escapes();
+    bench_keys();
+    bench_series();
+    return bench_snap() | bench_num() | bench_render(update_baseline) | bench_blob() | bench_mux() | bench_popup() | bench_resize() | bench_tx() | bench_replay();
+}
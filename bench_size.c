@@ -0,0 +1,55 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The same output through stdio and through vt100_out, for the flash size
+// comparison in "make bench": a cursor move, a colour, a decimal and a
+// value in volts, as the library sent them with fprintf before.
+
+#include <stdio.h>
+#include <stdint.h>
+#include "vt100_out.h"
+
+#ifdef SIZE_STDIO
+int main(int argc, char **argv) {
+    uint16_t mv = 3854 + argc;
+    fprintf(stdout, "\x1B[%u;%uH", argc, argc + 6);
+    fprintf(stdout, "\x1B[%um", 30 + argc);
+    fprintf(stdout, "%u", mv);
+    fprintf(stdout, "%1u.%03u", mv / 1000, mv % 1000);
+    return 0;
+}
+#else
+int main(int argc, char **argv) {
+    static uint8_t buf[64];
+    vt100_out_t o;
+    uint16_t mv = 3854 + argc;
+    vt100_out_init(&o, buf, sizeof(buf), vt100_sink_stdout, NULL);
+    vt100_out_csi2(&o, argc, argc + 6, 'H');
+    vt100_out_csi(&o, 30 + argc, 'm');
+    vt100_out_u16(&o, mv);
+    vt100_out_mv(&o, mv);
+    vt100_out_flush(&o);
+    return 0;
+}
+#endif
@@ -0,0 +1,74 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// Build-time generator: runs Print_Background through the library once
+// per terminal flavour and writes the resulting byte streams as PROGMEM
+// arrays to stdout. The Makefile turns that into bms_blob.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bms_screen.h"
+
+#define BLOB_MAX 8192
+
+static uint8_t blob[BLOB_MAX];
+static uint16_t blob_len;
+
+static void blob_sink(void *ctx, const uint8_t *data, uint16_t len) {
+    if (blob_len + len > BLOB_MAX) { fprintf(stderr, "bms_blob_gen: screen over %u bytes\n", BLOB_MAX); exit(1); }
+    while (len--) blob[blob_len++] = *data++;
+}
+
+static void blob_emit(const char *name, const char *var, uint8_t caps) {
+    static vt100_cell_t front[BMS_ROWS * BMS_COLS], back[BMS_ROWS * BMS_COLS];
+    vt100_instance_t vt;
+    uint8_t buf[256];
+    uint16_t n;
+
+    blob_len = 0;
+    vt100_init(&vt);
+    vt.caps = caps;
+    vt100_out_init(&vt.out, buf, sizeof(buf), blob_sink, NULL);
+    vt100_shadow(&vt, front, back, BMS_ROWS, BMS_COLS);
+    vt100_begin(&vt);
+    Print_Background(&vt);
+    vt100_flush(&vt);
+
+    printf("\n#define BMS_BLOB_%s_CAPS 0x%02X\n", name, caps);
+    printf("#define BMS_BLOB_%s_LEN  %u\n", name, blob_len);
+    printf("static const uint8_t %s[BMS_BLOB_%s_LEN] PROGMEM = {", var, name);
+    for (n = 0; n < blob_len; n++) printf("%s0x%02X,", (n % 16) ? " " : "\n    ", blob[n]);
+    printf("\n};\n");
+}
+
+int main(int argc, char **argv) {
+    printf("// Generated by bms_blob_gen from Print_Background, do not edit.\n");
+    printf("// vt100_begin() and the BMS background at %ux%u, the terminal is cleared first.\n\n", BMS_ROWS, BMS_COLS);
+    Bms_Layout(BMS_ROWS, BMS_COLS);
+    printf("#pragma once\n#include <stdint.h>\n#include \"vt100_out.h\"\n");
+    blob_emit("PLAIN", "bms_blob_plain", 0);
+    blob_emit("DEC", "bms_blob_dec", VT100_CAP_DEC_LINES | VT100_CAP_REP);
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The BMS status screen of the demo, shared by main.c and bench.c.
+
+#include "bms_screen.h"
+
+static const vt100_lay_t bms_layout[BMS_LAYOUT_NODES] PROGMEM = {
+    [BMS_BOX_SCREEN]     = { 0,             VT100_LAY_ROWS, 1, 0,  0 },
+    [BMS_BOX_TITLE]      = { BMS_BOX_SCREEN, VT100_LAY_ROWS, 0, 1,  0 },
+    [BMS_BOX_RULE]       = { BMS_BOX_SCREEN, VT100_LAY_ROWS, 0, 1,  0 },
+    [BMS_BOX_BODY]       = { BMS_BOX_SCREEN, VT100_LAY_COLS, 0, CEL_COUNT + 4, 0 },
+    [BMS_BOX_CELLS]      = { BMS_BOX_BODY,  VT100_LAY_ROWS, 0, 23, 0 },
+    [BMS_BOX_FLAGS]      = { BMS_BOX_BODY,  VT100_LAY_COLS, 1, 46, 1 },
+    [BMS_BOX_NAME]       = { BMS_BOX_FLAGS, VT100_LAY_ROWS, 0, 20, 1 },
+    [BMS_BOX_NAME_RULE]  = { BMS_BOX_FLAGS, VT100_LAY_ROWS, 0, 1,  0 },
+    [BMS_BOX_COUNT]      = { BMS_BOX_FLAGS, VT100_LAY_ROWS, 0, 9,  0 },
+    [BMS_BOX_COUNT_RULE] = { BMS_BOX_FLAGS, VT100_LAY_ROWS, 0, 1,  0 },
+    [BMS_BOX_LAST]       = { BMS_BOX_FLAGS, VT100_LAY_ROWS, 0, 13, 1 },
+    [BMS_BOX_LOG]        = { BMS_BOX_SCREEN, VT100_LAY_ROWS, 1, 4,  1 },
+    [BMS_BOX_LOG_TEXT]   = { BMS_BOX_LOG,   VT100_LAY_ROWS, 0, 2,  1 },
+};
+
+vt100_box_t bms_box[BMS_BOXES];
+vt100_region_t bms_regions[BMS_REGION_COUNT];
+
+// Raw and Volts of every cell, placed by Print_Background
+static vt100_num_t bms_raw[CEL_COUNT], bms_volts[CEL_COUNT];
+
+static void bms_region(vt100_region_t *r, uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t prio) {
+    r->x1 = x1; r->y1 = y1; r->x2 = x2; r->y2 = y2; r->prio = prio;
+}
+
+// Boxes and regions for a rows x cols terminal, false if it is smaller
+// than BMS_ROWS x BMS_COLS.
+bool Bms_Layout(uint8_t rows, uint8_t cols) {
+    const vt100_box_t *cells = &bms_box[BMS_BOX_CELLS], *flags = &bms_box[BMS_BOX_FLAGS];
+    vt100_box_t *b;
+    if (!vt100_layout(bms_layout, BMS_LAYOUT_NODES, bms_box, rows, cols)) return false;
+    b = &bms_box[BMS_BOX_STATS];
+    b->x1 = flags->x1 + 3; b->x2 = b->x1 + BMS_STATS_ROWS - 1;
+    b->y2 = flags->y2 - 1; b->y1 = b->y2 - BMS_STATS_COLS + 1;
+    b = &bms_box[BMS_BOX_HELP];
+    b->x1 = cells->x1 + 4; b->x2 = b->x1 + BMS_HELP_ROWS - 1;
+    b->y1 = cells->y1 + 4; b->y2 = b->y1 + BMS_HELP_COLS - 1;
+    bms_region(&bms_regions[0], flags->x1 + 3, bms_box[BMS_BOX_NAME].y1, flags->x1 + 12, flags->y2 - 1, 3);  // Name column, alarm flags
+    bms_region(&bms_regions[1], cells->x1 + 3, cells->y1 + 1, cells->x2 - 1, cells->y2 - 1, 2);             // Cell, Raw, Volts
+    bms_region(&bms_regions[2], bms_box[BMS_BOX_TITLE].x1, bms_box[BMS_BOX_TITLE].y1 + 11,
+               bms_box[BMS_BOX_TITLE].x1, bms_box[BMS_BOX_TITLE].y1 + 33, 1);                              // Up Time
+    return true;
+}
+
+void Bms_Box(vt100_instance_t *vt, uint8_t box) {
+    vt->x1 = bms_box[box].x1; vt->y1 = bms_box[box].y1; vt->x2 = bms_box[box].x2; vt->y2 = bms_box[box].y2;
+}
+
+const char pStr_BMS[]               PROGMEM = {"BMS"};
+const char pStr_Up_Time[]           PROGMEM = {"Up Time :"};
+const char pStr_Build_on[]          PROGMEM = {"Build on : " __DATE__ " " __TIME__};
+const char pStr_Cell[]              PROGMEM = {"Cell"};
+const char pStr_Raw[]               PROGMEM = {"Raw"};
+const char pStr_Volts[]             PROGMEM = {"Volts"};
+const char pStr_Name[]              PROGMEM = {"Name"};
+const char pStr_Count[]             PROGMEM = {"Count"};
+const char pStr_Last_Time[]         PROGMEM = {"Last Time"};
+const char pStr_Monitor_XREADY[]    PROGMEM = {"Monitor XREADY"};
+const char pStr_Monitor_ALERT[]     PROGMEM = {"Monitor ALERT"};
+const char pStr_Under_Voltage[]     PROGMEM = {"Under Voltage"};
+const char pStr_Over_Voltage[]      PROGMEM = {"Over Voltage"};
+const char pStr_Load_Short_Circuit[] PROGMEM = {"Load Short Circuit"};
+const char pStr_Load_Overcurrent[]  PROGMEM = {"Load Overcurrent"};
+const char pStr_USER_SWITCH[]       PROGMEM = {"USER SWITCH"};
+const char pStr_USER_DISCHG_TEMP[]  PROGMEM = {"USER DISCHG_TEMP"};
+const char pStr_USER_CHG_TEMP[]     PROGMEM = {"USER CHG_TEMP"};
+const char pStr_USER_CHG_OCD[]      PROGMEM = {"USER CHG_OCD"};
+const char pStr_Help_F1[]           PROGMEM = {"F1         this help"};
+const char pStr_Help_F2[]           PROGMEM = {"F2         frame counters"};
+const char pStr_Help_Up_Dn[]        PROGMEM = {"Up, Down   trend cell"};
+const char pStr_Help_Pg[]           PROGMEM = {"PgUp, PgDn key log"};
+const char pStr_Help_Ctrl_C[]       PROGMEM = {"Ctrl-C     quit"};
+
+// Text sits at fixed offsets from the left edge of its box.
+static void bms_text(vt100_instance_t *vt, uint8_t x, uint8_t box, uint8_t dy, const char *txt) {
+    vt->x1 = x; vt->y1 = bms_box[box].y1 + dy; vt100_print_text_P(vt, (char *)txt);
+}
+
+static void bms_rule(vt100_instance_t *vt, uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, vt100_divider_t dt) {
+    vt->x1 = x1; vt->y1 = y1; vt->x2 = x2; vt->y2 = y2; vt100_draw_divider(vt, dt, true);
+}
+
+void Print_Background(vt100_instance_t *vt) {
+    const vt100_box_t *s = &bms_box[BMS_BOX_SCREEN], *c = &bms_box[BMS_BOX_CELLS], *f = &bms_box[BMS_BOX_FLAGS];
+    uint8_t t = bms_box[BMS_BOX_TITLE].x1, x;
+    Bms_Box(vt, BMS_BOX_SCREEN); vt100_draw_box(vt);
+    bms_text(vt, t, BMS_BOX_TITLE, 25, pStr_BMS);
+    bms_text(vt, t, BMS_BOX_TITLE, 1,  pStr_Up_Time);
+    bms_text(vt, t, BMS_BOX_TITLE, 35, pStr_Build_on);
+    x = bms_box[BMS_BOX_RULE].x1; bms_rule(vt, x, s->y1, x, s->y2, Horizontal);
+    Bms_Box(vt, BMS_BOX_CELLS); vt100_draw_box(vt);
+    bms_text(vt, c->x1 + 1, BMS_BOX_CELLS, 1,  pStr_Cell);
+    bms_text(vt, c->x1 + 1, BMS_BOX_CELLS, 8,  pStr_Raw);
+    bms_text(vt, c->x1 + 1, BMS_BOX_CELLS, 16, pStr_Volts);
+    bms_rule(vt, c->x1 + 2, c->y1, c->x1 + 2, c->y2, Horizontal);
+    bms_rule(vt, c->x1 + 2, c->y1 + 5,  c->x2, c->y1 + 5,  Vertical);
+    bms_rule(vt, c->x1 + 2, c->y1 + 14, c->x2, c->y1 + 14, Vertical);
+    for (uint8_t i = 0; i < CEL_COUNT; i++) {
+        char buf[VT100_NUM_MAX];
+        vt->x1 = c->x1 + 3 + i; vt->y1 = c->y1 + 2; vt100_utoa(buf, i + 1); vt100_print_text(vt, buf);
+        vt100_num_init(&bms_raw[i], c->x1 + 3 + i, c->y1 + 7, 5, 0, VT100_NUM_LEFT);
+        vt100_num_init(&bms_volts[i], c->x1 + 3 + i, c->y1 + 16, 6, 3, VT100_NUM_LEFT);
+    }
+    Bms_Box(vt, BMS_BOX_FLAGS); vt100_draw_box(vt);
+    bms_text(vt, f->x1 + 1, BMS_BOX_NAME,  5, pStr_Name);
+    bms_text(vt, f->x1 + 1, BMS_BOX_COUNT, 1, pStr_Count);
+    bms_text(vt, f->x1 + 1, BMS_BOX_LAST,  2, pStr_Last_Time);
+    bms_rule(vt, f->x1 + 2, f->y1, f->x1 + 2, f->y2, Horizontal);
+    bms_rule(vt, f->x1 + 2, bms_box[BMS_BOX_NAME_RULE].y1, f->x2, bms_box[BMS_BOX_NAME_RULE].y1, Vertical);
+    bms_rule(vt, f->x1 + 2, bms_box[BMS_BOX_COUNT_RULE].y1, f->x2, bms_box[BMS_BOX_COUNT_RULE].y1, Vertical);
+    vt->set.Default_Color = RED; vt->set.Format = BLINKING;
+    bms_text(vt, f->x1 + 3,  BMS_BOX_NAME, 1, pStr_Monitor_XREADY);
+    bms_text(vt, f->x1 + 4,  BMS_BOX_NAME, 1, pStr_Monitor_ALERT);
+    bms_text(vt, f->x1 + 5,  BMS_BOX_NAME, 1, pStr_Under_Voltage);
+    bms_text(vt, f->x1 + 6,  BMS_BOX_NAME, 1, pStr_Over_Voltage);
+    bms_text(vt, f->x1 + 7,  BMS_BOX_NAME, 1, pStr_Load_Short_Circuit);
+    bms_text(vt, f->x1 + 8,  BMS_BOX_NAME, 1, pStr_Load_Overcurrent);
+    bms_text(vt, f->x1 + 9,  BMS_BOX_NAME, 1, pStr_USER_SWITCH);
+    bms_text(vt, f->x1 + 10, BMS_BOX_NAME, 1, pStr_USER_DISCHG_TEMP);
+    bms_text(vt, f->x1 + 11, BMS_BOX_NAME, 1, pStr_USER_CHG_TEMP);
+    bms_text(vt, f->x1 + 12, BMS_BOX_NAME, 1, pStr_USER_CHG_OCD);
+    Bms_Box(vt, BMS_BOX_LOG); vt100_draw_box(vt);
+}
+
+void Print_Help(vt100_instance_t *vt) {
+    uint8_t x = bms_box[BMS_BOX_HELP].x1;
+    Bms_Box(vt, BMS_BOX_HELP); vt100_draw_box(vt);
+    bms_text(vt, x + 1, BMS_BOX_HELP, 2, pStr_Help_F1);
+    bms_text(vt, x + 2, BMS_BOX_HELP, 2, pStr_Help_F2);
+    bms_text(vt, x + 3, BMS_BOX_HELP, 2, pStr_Help_Up_Dn);
+    bms_text(vt, x + 4, BMS_BOX_HELP, 2, pStr_Help_Pg);
+    bms_text(vt, x + 5, BMS_BOX_HELP, 2, pStr_Help_Ctrl_C);
+}
+
+void Print_Uptime(vt100_instance_t *vt, uint32_t uptime_s) {
+    char buf[VT100_NUM_MAX + 6];
+    uint8_t m = uptime_s / 60 % 60, sec = uptime_s % 60;
+    uint8_t n = vt100_utoa(buf, uptime_s / 3600);
+    buf[n++] = ':'; buf[n++] = '0' + m / 10;   buf[n++] = '0' + m % 10;
+    buf[n++] = ':'; buf[n++] = '0' + sec / 10; buf[n++] = '0' + sec % 10;
+    buf[n] = 0;
+    vt->x1 = bms_box[BMS_BOX_TITLE].x1; vt->y1 = bms_box[BMS_BOX_TITLE].y1 + 11; vt100_print_text(vt, buf);
+}
+
+// Cell number and gauge of the newest sample, the sparkline below and
+// min, avg and max of the window on the last row.
+void Print_Trend(vt100_instance_t *vt, const vt100_series_t *s, uint8_t cell) {
+    char buf[VT100_NUM_MAX + 6] = "Cell ";
+    uint8_t n = 5 + vt100_utoa(buf + 5, cell + 1);
+    uint8_t x = bms_box[BMS_BOX_FLAGS].x1 + 13, y = bms_box[BMS_BOX_NAME].y1;
+    while (n < 8) buf[n++] = ' ';
+    buf[n] = 0;
+    vt->x1 = x; vt->y1 = y + 1; vt100_print_text(vt, buf);
+    vt->x1 = x; vt->y1 = y + 9; vt->y2 = y + 19;
+    vt100_draw_gauge(vt, vt100_series_last(s), s->lo, s->hi);
+    vt->x1 = x + 1; vt->y1 = y; vt->x2 = x + 3; vt->y2 = y + BMS_TREND_W - 1;
+    vt100_draw_sparkline(vt, s);
+    vt->x1 = x + 4;
+    vt->y1 = y + 1;  vt100_mvtoa(buf, vt100_series_min(s)); vt100_print_text(vt, buf);
+    vt->y1 = y + 7;  vt100_mvtoa(buf, vt100_series_avg(s)); vt100_print_text(vt, buf);
+    vt->y1 = y + 13; vt100_mvtoa(buf, vt100_series_max(s)); vt100_print_text(vt, buf);
+}
+
+// Only the digits that changed since the last call go out, the worst
+// cell's Volts in reverse.
+void Print_Values(vt100_instance_t *vt, const uint16_t *cells_mv, uint32_t uptime_s) {
+    uint8_t worst = 0;
+    Print_Uptime(vt, uptime_s);
+    for (uint8_t i = 1; i < CEL_COUNT; i++) {
+        if (cells_mv[i] < cells_mv[worst]) worst = i;
+    }
+    for (uint8_t i = 0; i < CEL_COUNT; i++) {
+        vt100_draw_num(vt, &bms_raw[i], cells_mv[i]);
+        if (i == worst) vt->set.Format = REVERSE;
+        vt100_draw_num(vt, &bms_volts[i], cells_mv[i]);
+    }
+    vt100_flush(vt);
+}
@@ -0,0 +1,84 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include "vt100_print.h"
+#include "vt100_layout.h"
+
+#define BMS_ROWS  27    // the smallest screen the layout fits, and the blob's
+#define BMS_COLS  71
+#define BMS_ROWS_MAX 60
+#define BMS_COLS_MAX 200
+#define CEL_COUNT 15
+
+// Trend of the selected cell, rows 17 to 21 of the Name column
+#define BMS_TREND_W  20
+#define BMS_TREND_LO 3600
+#define BMS_TREND_HI 4200
+
+// Boxes of bms_box. The title row, the cell table and the Count column
+// keep their size, the Name and Last Time columns share the extra width
+// and the event log the extra height.
+enum {
+    BMS_BOX_SCREEN,
+    BMS_BOX_TITLE,
+    BMS_BOX_RULE,
+    BMS_BOX_BODY,
+    BMS_BOX_CELLS,
+    BMS_BOX_FLAGS,
+    BMS_BOX_NAME,
+    BMS_BOX_NAME_RULE,
+    BMS_BOX_COUNT,
+    BMS_BOX_COUNT_RULE,
+    BMS_BOX_LAST,
+    BMS_BOX_LOG,
+    BMS_BOX_LOG_TEXT,   // the event log panel
+    BMS_LAYOUT_NODES,
+    // Popups placed after the layout: frame counters (F2) over the alarm
+    // flags, key help (F1) over the cells
+    BMS_BOX_STATS = BMS_LAYOUT_NODES,
+    BMS_BOX_HELP,
+    BMS_BOXES
+};
+
+#define BMS_STATS_ROWS 10
+#define BMS_STATS_COLS 30
+#define BMS_HELP_ROWS  7
+#define BMS_HELP_COLS  28
+#define BMS_LOG_COLS_MAX (BMS_COLS_MAX - 4)
+
+extern vt100_box_t bms_box[BMS_BOXES];
+
+// Alarm flags before cell voltages before uptime, labels go last.
+#define BMS_REGION_COUNT 3
+extern vt100_region_t bms_regions[BMS_REGION_COUNT];
+
+bool Bms_Layout(uint8_t rows, uint8_t cols);
+void Bms_Box(vt100_instance_t *vt, uint8_t box);
+void Print_Background(vt100_instance_t *vt);
+void Print_Help(vt100_instance_t *vt);
+void Print_Uptime(vt100_instance_t *vt, uint32_t uptime_s);
+void Print_Trend(vt100_instance_t *vt, const vt100_series_t *s, uint8_t cell);
+void Print_Values(vt100_instance_t *vt, const uint16_t *cells_mv, uint32_t uptime_s);
@@ -24,11 +24,28 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
 #include "vt100_print.h"
+#include "vt100_ring.h"
+#include "vt100_input.h"
+#include "vt100_sched.h"
+#include "vt100_log.h"
+#include "vt100_snap.h"
+#include "bms_screen.h"
+#include "bms_blob.h"
+#include "vt100_mux.h"
+#include "vt100_rec.h"
+#include "vt100_tx.h"
 
 struct termios orig_termios;
 
@@ -51,243 +68,566 @@ void enableRawMode() {
     raw.c_cflag |= (CS8);
     raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
     raw.c_cc[VMIN] = 0;
-    raw.c_cc[VTIME] = 1;
+    raw.c_cc[VTIME] = 0;    // reads only follow a poll() that saw data
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) die("tcsetattr");
 }
 
-typedef enum  {
-    VT100_Term_State_IDLE,
-    VT100_Term_State_ESCS,               // escape sequence
-    VT100_Term_State_ANSI_Key_Mode_Reset,// escape sequence + [
-    VT100_Term_State_ANSI_Key_Mode_Set,  // escape sequence + O
-    VT100_Term_State_Skip_Char
-} VT100_Term_State;
-
-
-VT100_Term_State vt100_ts = VT100_Term_State_IDLE;
-
-typedef enum  {
-    KBD_BTN_NULL        = 0,
-    KBD_BTN_KEY_ENTER,
-    KBD_BTN_KEY_TAB,
-    KBD_BTN_KEY_ESC,
-    KBD_BTN_KEY_BACKSPACE,
-    KBD_BTN_KEY_UP,
-    KBD_BTN_KEY_DOWN,
-    KBD_BTN_KEY_RIGHT,
-    KBD_BTN_KEY_LEFT,
-    KBD_BTN_KEY_F1,
-    KBD_BTN_KEY_F2,
-    KBD_BTN_KEY_F3,
-    KBD_BTN_KEY_F4,
-    KBD_BTN_KEY_HOME,
-    KBD_BTN_KEY_END,
-    KBD_BTN_CTRL_C,
-    KBD_BTN_KEY_INSERT,
-    KBD_BTN_KEY_DELETE,
-    KBD_BTN_KEY_PG_UP,
-    KBD_BTN_KEY_PG_DN
-} KeyboardButtons;
-
-static KeyboardButtons Keyboard_Pressed = KBD_BTN_NULL;
-static KeyboardButtons Keyboard_Temp    = KBD_BTN_NULL;
-u_int8_t UDR0;
-
-void UDR_INT() {
-    u_int8_t c = UDR0;
-
-    switch (vt100_ts) {
-        case VT100_Term_State_IDLE:
-            switch (c) {
-                case 0x1B: vt100_ts = VT100_Term_State_ESCS; break;
-                case 0x03: Keyboard_Pressed = KBD_BTN_CTRL_C;        break;  // CTRL + C
-                case 0x09: Keyboard_Pressed = KBD_BTN_KEY_TAB;       break;  // TAB
-                case 0x0D: Keyboard_Pressed = KBD_BTN_KEY_ENTER;     break;
-                case 0x7F: Keyboard_Pressed = KBD_BTN_KEY_BACKSPACE; break;
-                default: {
-                    if ((c != 127) && (c > 0x1F)) {
-                        printf_P(PSTR("Load_Buffer: %d ('%c')\r\n"), c, c);
-                    } else { printf_P(PSTR("Unk not printable char: %d ('%c')\r\n"), c, c); }
-                }
-            }
-            break;
+vt100_instance_t vt;
+vt100_cell_t scr_front[BMS_ROWS_MAX * BMS_COLS_MAX];
+vt100_cell_t scr_back[BMS_ROWS_MAX * BMS_COLS_MAX];
+bool fits;              // the terminal is at least BMS_ROWS x BMS_COLS
+uint8_t out_buf[8192];   // a whole frame, it leaves in one write
+
+// Three threads: Sampler publishes the cells every SAMPLE_MS, Input turns
+// stdin into key records, the main thread renders. The other two wake it
+// through a pipe, so a slow terminal holds up neither of them.
+int wake[2];
+
+void Wake() {
+    uint8_t c = 0;
+    ssize_t n = write(wake[1], &c, 1);  // a full pipe is awake already
+    (void)n;
+}
+
+vt100_rec_t session;    // -w, both streams of the session into a file
+bool session_on;
+
+// Output leaves through a ring that Transmit empties into stdout, as a TX
+// interrupt would into the UART. Only Transmit blocks on a terminal that
+// reads slowly; the ring fills, and then frames are skipped instead of
+// waited on. stdout stays blocking, it shares its file description with
+// stdin and the shell.
+#define TX_RING_SIZE 8192
+
+uint8_t tx_buf[TX_RING_SIZE];
+vt100_tx_t tx;
+pthread_mutex_t tx_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t tx_cond = PTHREAD_COND_INITIALIZER;
+bool tx_busy;           // Transmit holds bytes taken from the ring
+
+void Tx_Kick(void *ctx) {
+    pthread_mutex_lock(&tx_lock);
+    pthread_cond_broadcast(&tx_cond);
+    pthread_mutex_unlock(&tx_lock);
+}
 
-                case VT100_Term_State_ESCS:
-                    vt100_ts = VT100_Term_State_IDLE;
-                    switch (c) {
-                        case 0x1B: Keyboard_Pressed = KBD_BTN_KEY_ESC; break;
-                        case '[': { vt100_ts = VT100_Term_State_ANSI_Key_Mode_Reset; } break;
-                        case 'O': { vt100_ts = VT100_Term_State_ANSI_Key_Mode_Set; } break;
-                        default: printf_P(PSTR("UNKNOWN GROUP %d ('%c')\r\n"), c, c);
-                    }
-                    break;
-
-                        case VT100_Term_State_ANSI_Key_Mode_Reset: // '['
-                        case VT100_Term_State_ANSI_Key_Mode_Set:   // 'O'
-                            vt100_ts = VT100_Term_State_IDLE;
-                            switch (c) {
-                                case 'A': Keyboard_Pressed = KBD_BTN_KEY_UP;    break; // BT_KEY_UP;
-                                case 'B': Keyboard_Pressed = KBD_BTN_KEY_DOWN;  break; // BT_KEY_DOWN;
-                                case 'C': Keyboard_Pressed = KBD_BTN_KEY_RIGHT; break; // BT_KEY_RIGHT;
-                                case 'D': Keyboard_Pressed = KBD_BTN_KEY_LEFT;  break; // BT_KEY_LEFT;
-                                case 'P': Keyboard_Pressed = KBD_BTN_KEY_F1;    break; // BT_KEY_F1;
-                                case 'Q': Keyboard_Pressed = KBD_BTN_KEY_F2;    break; // BT_KEY_F2;
-                                case 'R': Keyboard_Pressed = KBD_BTN_KEY_F3;    break; // BT_KEY_F3;
-                                case 'S': Keyboard_Pressed = KBD_BTN_KEY_F4;    break; // BT_KEY_F4;
-                                case 'H': Keyboard_Pressed = KBD_BTN_KEY_HOME;  break; // 
-                                case 'F': Keyboard_Pressed = KBD_BTN_KEY_END;   break; // 
-                                case '2': Keyboard_Temp = KBD_BTN_KEY_INSERT;   vt100_ts = VT100_Term_State_Skip_Char;  break; // 
-                                case '3': Keyboard_Temp = KBD_BTN_KEY_DELETE;   vt100_ts = VT100_Term_State_Skip_Char;  break; // 
-                                case '5': Keyboard_Temp = KBD_BTN_KEY_PG_UP;    vt100_ts = VT100_Term_State_Skip_Char;  break; // 
-                                case '6': Keyboard_Temp = KBD_BTN_KEY_PG_DN;    vt100_ts = VT100_Term_State_Skip_Char;  break; //
-                                default: printf_P(PSTR("WTF %d ('%c')\r\n"), c, c);
-                            }
-                            break;
-
-                        case VT100_Term_State_Skip_Char:
-                            if (c == 0x7E) {
-                                switch (Keyboard_Temp) {
-                                    case KBD_BTN_KEY_INSERT:   Keyboard_Pressed = KBD_BTN_KEY_INSERT;   break;
-                                    case KBD_BTN_KEY_DELETE:   Keyboard_Pressed = KBD_BTN_KEY_DELETE;   break;
-                                    case KBD_BTN_KEY_PG_UP:    Keyboard_Pressed = KBD_BTN_KEY_PG_UP;    break;
-                                    case KBD_BTN_KEY_PG_DN:    Keyboard_Pressed = KBD_BTN_KEY_PG_DN;    break;
-                                    default: printf_P(PSTR("VT100_Term_State_Skip_Char %d ('%c')\r\n"), c, c);
-                                }
-                            } else { printf_P(PSTR("wtf! Tilda\r\n")); }
-                            Keyboard_Temp = KBD_BTN_NULL;
-                            vt100_ts = VT100_Term_State_IDLE;
-                            //printf_P(PSTR("VT100_Term_State_Skip_Char>>>VT100_Term_State_IDLE %d ('%c')\r\n"), c, c);
-                            break;
+void Tx_Wait(void *ctx) {
+    pthread_mutex_lock(&tx_lock);
+    while (vt100_ring_free(&tx.ring) == 0) pthread_cond_wait(&tx_cond, &tx_lock);
+    pthread_mutex_unlock(&tx_lock);
+}
+
+// Everything queued is on the terminal, before the program exits.
+void Tx_Drain() {
+    pthread_mutex_lock(&tx_lock);
+    while (vt100_tx_pending(&tx) || tx_busy) pthread_cond_wait(&tx_cond, &tx_lock);
+    pthread_mutex_unlock(&tx_lock);
+}
+
+void *Transmit(void *arg) {
+    uint8_t chunk[512];
+    uint16_t n, off;
+    ssize_t w;
+    while (1) {
+        pthread_mutex_lock(&tx_lock);
+        while (vt100_tx_pending(&tx) == 0) pthread_cond_wait(&tx_cond, &tx_lock);
+        n = vt100_tx_read(&tx, chunk, sizeof(chunk));
+        tx_busy = true;
+        pthread_cond_broadcast(&tx_cond);   // room for a waiting sink
+        pthread_mutex_unlock(&tx_lock);
+        for (off = 0; off < n; off += w) {
+            if ((w = write(STDOUT_FILENO, chunk + off, n - off)) > 0) continue;
+            if (w == -1 && errno != EINTR) die("write");
+            w = 0;
+        }
+        pthread_mutex_lock(&tx_lock);
+        tx_busy = false;
+        pthread_cond_broadcast(&tx_cond);
+        pthread_mutex_unlock(&tx_lock);
     }
+    return NULL;
+}
+
+uint32_t Now_us() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000UL + t.tv_nsec / 1000;
+}
+
+#define KEY_RING_SIZE 256
+#define KEY_REC       9     // key, mods, ch, paste length low, high, read time in us LE
+
+uint8_t key_buf[KEY_RING_SIZE];
+vt100_ring_t keys;  // Input -> main thread, KEY_REC bytes per key
+vt100_parser_t kbd;
+uint16_t paste_len; // Input only, ends up in the KBD_BTN_PASTE_END record
+uint32_t read_us;   // Input only, when the bytes being parsed came in
+
+void Key_Event(void *ctx, const vt100_key_event_t *ev) {
+    uint8_t rec[KEY_REC] = { ev->key, ev->mods, ev->ch, paste_len & 0xFF, paste_len >> 8,
+                             read_us & 0xFF, read_us >> 8 & 0xFF, read_us >> 16 & 0xFF, read_us >> 24 };
+    if (ev->key == KBD_BTN_PASTE) { paste_len += ev->len; return; }
+    if (ev->key == KBD_BTN_PASTE_END) paste_len = 0;
+    if (ev->key == KBD_BTN_CPR) { rec[3] = ev->x; rec[4] = ev->y; }
+    // A record must go in whole or not at all
+    if (vt100_ring_free(&keys) < KEY_REC) { keys.overflow++; return; }
+    vt100_ring_write(&keys, rec, KEY_REC);
 }
 
+#define LOG_LINES 32
 
+char log_buf[VT100_LOG_BUF(LOG_LINES, 1, BMS_LOG_COLS_MAX)];
+vt100_log_t klog;       // decoded keys, PgUp and PgDn page through it
+char line[BMS_LOG_COLS_MAX + 1];
+uint8_t line_len;
+
+void Line(const char *s) {
+    while (*s && line_len < sizeof(line) - 1) line[line_len++] = *s++;
+    line[line_len] = 0;
+}
+
+void Line_P(const char *s) {
+    char c;
+    while ((c = pgm_read_byte(s++)) && line_len < sizeof(line) - 1) line[line_len++] = c;
+    line[line_len] = 0;
+}
 
+void Line_U(uint32_t v) {
+    char buf[VT100_NUM_MAX];
+    vt100_utoa(buf, v);
+    Line(buf);
+}
 
+void Print_Char(const char *msg, u_int8_t c) {
+    char ch[2] = { isprint(c) ? c : '.', 0 };
+    Line_P(msg);
+    Line_U(c);
+    Line_P(PSTR(" ('"));
+    Line(ch);
+    Line_P(PSTR("')"));
+}
 
-void Print_Pressed_Decoder(KeyboardButtons _key) {
+void Print_Pressed_Decoder(KeyboardButtons _key, uint8_t _mods, uint8_t _ch, uint16_t _len) {
+    line_len = 0;
+    line[0] = 0;
+    if (_mods & VT100_MOD_SHIFT) Line_P(PSTR("Shift+"));
+    if (_mods & VT100_MOD_ALT)   Line_P(PSTR("Alt+"));
+    if (_mods & VT100_MOD_CTRL)  Line_P(PSTR("Ctrl+"));
+    if (_mods & VT100_MOD_META)  Line_P(PSTR("Meta+"));
     switch (_key) {
-        case KBD_BTN_NULL:      break;
-        case KBD_BTN_KEY_ENTER:     printf_P(PSTR("KBD_BTN_KEY_ENTER\r\n"));        break;
-        case KBD_BTN_KEY_TAB:       printf_P(PSTR("KBD_BTN_KEY_TAB\r\n"));          break;
-        case KBD_BTN_KEY_ESC:       printf_P(PSTR("KBD_BTN_KEY_ESC\r\n"));          break;
-        case KBD_BTN_KEY_BACKSPACE: printf_P(PSTR("KBD_BTN_KEY_BACKSPACE\r\n"));    break;
-        case KBD_BTN_KEY_UP:        printf_P(PSTR("KBD_BTN_KEY_UP\r\n"));           break;
-        case KBD_BTN_KEY_DOWN:      printf_P(PSTR("KBD_BTN_KEY_DOWN\r\n"));         break;
-        case KBD_BTN_KEY_RIGHT:     printf_P(PSTR("KBD_BTN_KEY_RIGHT\r\n"));        break;
-        case KBD_BTN_KEY_LEFT:      printf_P(PSTR("KBD_BTN_KEY_LEFT\r\n"));         break;
-        case KBD_BTN_KEY_F1:        printf_P(PSTR("KBD_BTN_KEY_F1\r\n"));           break;
-        case KBD_BTN_KEY_F2:        printf_P(PSTR("KBD_BTN_KEY_F2\r\n"));           break;
-        case KBD_BTN_KEY_F3:        printf_P(PSTR("KBD_BTN_KEY_F3\r\n"));           break;
-        case KBD_BTN_KEY_F4:        printf_P(PSTR("KBD_BTN_KEY_F4\r\n"));           break;
-        case KBD_BTN_KEY_HOME:      printf_P(PSTR("KBD_BTN_KEY_HOME\r\n"));         break;
-        case KBD_BTN_KEY_END:       printf_P(PSTR("KBD_BTN_KEY_END\r\n"));          break;
-        case KBD_BTN_KEY_INSERT:    printf_P(PSTR("KBD_BTN_KEY_INSERT\r\n"));       break;
-        case KBD_BTN_KEY_DELETE:    printf_P(PSTR("KBD_BTN_KEY_DELETE\r\n"));       break;
-        case KBD_BTN_KEY_PG_UP:     printf_P(PSTR("KBD_BTN_KEY_PG_UP\r\n"));        break;
-        case KBD_BTN_KEY_PG_DN:     printf_P(PSTR("KBD_BTN_KEY_PG_DN\r\n"));        break;
-        case KBD_BTN_CTRL_C:        printf_P(PSTR("KBD_BTN_CTRL_C\r\n"));           break;
+        case KBD_BTN_NULL:                                                                          break;
+        case KBD_BTN_KEY_ENTER:     Line_P(PSTR("KBD_BTN_KEY_ENTER"));                              break;
+        case KBD_BTN_KEY_TAB:       Line_P(PSTR("KBD_BTN_KEY_TAB"));                                break;
+        case KBD_BTN_KEY_ESC:       Line_P(PSTR("KBD_BTN_KEY_ESC"));                                break;
+        case KBD_BTN_KEY_BACKSPACE: Line_P(PSTR("KBD_BTN_KEY_BACKSPACE"));                          break;
+        case KBD_BTN_KEY_UP:        Line_P(PSTR("KBD_BTN_KEY_UP"));                                 break;
+        case KBD_BTN_KEY_DOWN:      Line_P(PSTR("KBD_BTN_KEY_DOWN"));                               break;
+        case KBD_BTN_KEY_RIGHT:     Line_P(PSTR("KBD_BTN_KEY_RIGHT"));                              break;
+        case KBD_BTN_KEY_LEFT:      Line_P(PSTR("KBD_BTN_KEY_LEFT"));                               break;
+        case KBD_BTN_KEY_F1:        Line_P(PSTR("KBD_BTN_KEY_F1"));                                 break;
+        case KBD_BTN_KEY_F2:        Line_P(PSTR("KBD_BTN_KEY_F2"));                                 break;
+        case KBD_BTN_KEY_F3:        Line_P(PSTR("KBD_BTN_KEY_F3"));                                 break;
+        case KBD_BTN_KEY_F4:        Line_P(PSTR("KBD_BTN_KEY_F4"));                                 break;
+        case KBD_BTN_KEY_HOME:      Line_P(PSTR("KBD_BTN_KEY_HOME"));                               break;
+        case KBD_BTN_KEY_END:       Line_P(PSTR("KBD_BTN_KEY_END"));                                break;
+        case KBD_BTN_KEY_INSERT:    Line_P(PSTR("KBD_BTN_KEY_INSERT"));                             break;
+        case KBD_BTN_KEY_DELETE:    Line_P(PSTR("KBD_BTN_KEY_DELETE"));                             break;
+        case KBD_BTN_KEY_PG_UP:     Line_P(PSTR("KBD_BTN_KEY_PG_UP"));                              break;
+        case KBD_BTN_KEY_PG_DN:     Line_P(PSTR("KBD_BTN_KEY_PG_DN"));                              break;
+        case KBD_BTN_KEY_F5:        Line_P(PSTR("KBD_BTN_KEY_F5"));                                 break;
+        case KBD_BTN_KEY_F6:        Line_P(PSTR("KBD_BTN_KEY_F6"));                                 break;
+        case KBD_BTN_KEY_F7:        Line_P(PSTR("KBD_BTN_KEY_F7"));                                 break;
+        case KBD_BTN_KEY_F8:        Line_P(PSTR("KBD_BTN_KEY_F8"));                                 break;
+        case KBD_BTN_KEY_F9:        Line_P(PSTR("KBD_BTN_KEY_F9"));                                 break;
+        case KBD_BTN_KEY_F10:       Line_P(PSTR("KBD_BTN_KEY_F10"));                                break;
+        case KBD_BTN_KEY_F11:       Line_P(PSTR("KBD_BTN_KEY_F11"));                                break;
+        case KBD_BTN_KEY_F12:       Line_P(PSTR("KBD_BTN_KEY_F12"));                                break;
+        case KBD_BTN_CHAR:          Print_Char(PSTR("KBD_BTN_CHAR "), _ch);                         break;
+        case KBD_BTN_PASTE:                                                                         break;
+        case KBD_BTN_PASTE_END:
+            Line_P(PSTR("KBD_BTN_PASTE "));
+            Line_U(_len);
+            Line_P(PSTR(" bytes"));
+            break;
+        case KBD_BTN_CPR:
+            Line_P(PSTR("KBD_BTN_CPR "));
+            Line_U(_len & 0xFF);
+            Line_P(PSTR(";"));
+            Line_U(_len >> 8);
+            break;
+        case KBD_BTN_UNKNOWN:       Line_P(PSTR("KBD_BTN_UNKNOWN"));                                break;
+        case KBD_BTN_CTRL_C:        Line_P(PSTR("KBD_BTN_CTRL_C"));                                 break;
     }
+    if (line_len && fits) vt100_log_add(&klog, &vt, line);
 }
 
-#define CEL_COUNT 15
-
 u_int16_t cells_mv[CEL_COUNT] = {3854,3940,3901,3899,3988,3964,3978,3887,3899,3754,3999,3797,3992,3910,3959};
 
-const char pStr_BMS[]               PROGMEM = {"BMS"};
-const char pStr_Up_Time[]           PROGMEM = {"Up Time :"};
-const char pStr_Build_on[]          PROGMEM = {"Build on : " __DATE__ " " __TIME__};
-const char pStr_Cell[]              PROGMEM = {"Cell"};
-const char pStr_Raw[]               PROGMEM = {"Raw"};
-const char pStr_Volts[]             PROGMEM = {"Volts"};
-const char pStr_Name[]              PROGMEM = {"Name"};
-const char pStr_Count[]             PROGMEM = {"Count"};
-const char pStr_Last_Time[]         PROGMEM = {"Last Time"};
-const char pStr_Monitor_XREADY[]    PROGMEM = {"Monitor XREADY"};
-const char pStr_Monitor_ALERT[]     PROGMEM = {"Monitor ALERT"};
-const char pStr_Under_Voltage[]     PROGMEM = {"Under Voltage"};
-const char pStr_Over_Voltage[]      PROGMEM = {"Over Voltage"};
-const char pStr_Load_Short_Circuit[] PROGMEM = {"Load Short Circuit"};
-const char pStr_Load_Overcurrent[]  PROGMEM = {"Load Overcurrent"};
-const char pStr_USER_SWITCH[]       PROGMEM = {"USER SWITCH"};
-const char pStr_USER_DISCHG_TEMP[]  PROGMEM = {"USER DISCHG_TEMP"};
-const char pStr_USER_CHG_TEMP[]     PROGMEM = {"USER CHG_TEMP"};
-const char pStr_USER_CHG_OCD[]      PROGMEM = {"USER CHG_OCD"};
+#define TICK_MS     10
+#define SAMPLE_MS   100
+#define FPS_DEFAULT 10
 
+typedef struct {
+    uint16_t cells_mv[CEL_COUNT];
+    uint32_t uptime_s;
+} bms_sample_t;
 
+bms_sample_t sample_pub;    // behind the seqlock, Sampler -> main thread
+vt100_snap_t sample_snap;
+bms_sample_t sample;        // the main thread's copy
+vt100_seq_t sample_seen;
 
-vt100_instance_t vt;
+// Every sample also goes into a ring for the trend, so a renderer held up
+// by the terminal catches up on the history instead of skipping it.
+#define HIST_RING_SIZE 1024
+#define HIST_REC       (CEL_COUNT * 2)
 
-void Print_Background() {
-    vt.x1 = 1; vt.y1 = 1; vt.x2 = 27; vt.y2 = 71; vt100_draw_box(&vt);
-    vt.x1 = 2; vt.y1 = 27;  vt100_print_text_P(&vt, (char *)pStr_BMS);
-    vt.x1 = 2; vt.y1 = 3;   vt100_print_text_P(&vt, (char *)pStr_Up_Time);
-    vt.x1 = 2; vt.y1 = 37;  vt100_print_text_P(&vt, (char *)pStr_Build_on);
-    vt.x1 = 3; vt.y1 = 1; vt.x2 = 3; vt.y2 = 71; vt100_draw_divider(&vt, Horizontal, true);
-    vt.x1 = 4; vt.y1 = 2; vt.x2 = 22; vt.y2 = 24; vt100_draw_box(&vt);
-    vt.x1 = 5; vt.y1 = 3;   vt100_print_text_P(&vt, (char *)pStr_Cell);
-    vt.x1 = 5; vt.y1 = 10;  vt100_print_text_P(&vt, (char *)pStr_Raw);
-    vt.x1 = 5; vt.y1 = 18;  vt100_print_text_P(&vt, (char *)pStr_Volts);
-    vt.x1 = 6; vt.y1 = 2;  vt.x2 = 6;  vt.y2 = 24; vt100_draw_divider(&vt, Horizontal, true);
-    vt.x1 = 6; vt.y1 = 7;  vt.x2 = 22; vt.y2 = 7;  vt100_draw_divider(&vt, Vertical, true);
-    vt.x1 = 6; vt.y1 = 16; vt.x2 = 22; vt.y2 = 16; vt100_draw_divider(&vt, Vertical, true);
-    vt.x1 = 4; vt.y1 = 25; vt.x2 = 22; vt.y2 = 70; vt100_draw_box(&vt);
-    vt.x1 = 5; vt.y1 = 31;  vt100_print_text_P(&vt, (char *)pStr_Name);
-    vt.x1 = 5; vt.y1 = 48;  vt100_print_text_P(&vt, (char *)pStr_Count);
-    vt.x1 = 5; vt.y1 = 59;  vt100_print_text_P(&vt, (char *)pStr_Last_Time);
-    vt.x1 = 6; vt.y1 = 25;  vt.x2 = 6;  vt.y2 = 70;  vt100_draw_divider(&vt, Horizontal, true);
-    vt.x1 = 6; vt.y1 = 46;  vt.x2 = 22; vt.y2 = 46;  vt100_draw_divider(&vt, Vertical, true);
-    vt.x1 = 6; vt.y1 = 56;  vt.x2 = 22; vt.y2 = 56;  vt100_draw_divider(&vt, Vertical, true);
-    vt.set.Default_Color = RED; vt.set.Format = BLINKING;
-    vt.x1 = 7;  vt.y1 = 27; vt100_print_text_P(&vt, (char *)pStr_Monitor_XREADY);
-    vt.x1 = 8;  vt.y1 = 27; vt100_print_text_P(&vt, (char *)pStr_Monitor_ALERT);
-    vt.x1 = 9;  vt.y1 = 27; vt100_print_text_P(&vt, (char *)pStr_Under_Voltage);
-    vt.x1 = 10; vt.y1 = 27; vt100_print_text_P(&vt, (char *)pStr_Over_Voltage);
-    vt.x1 = 11; vt.y1 = 27; vt100_print_text_P(&vt, (char *)pStr_Load_Short_Circuit);
-    vt.x1 = 12; vt.y1 = 27; vt100_print_text_P(&vt, (char *)pStr_Load_Overcurrent);
-    vt.x1 = 13; vt.y1 = 27; vt100_print_text_P(&vt, (char *)pStr_USER_SWITCH);
-    vt.x1 = 14; vt.y1 = 27; vt100_print_text_P(&vt, (char *)pStr_USER_DISCHG_TEMP);
-    vt.x1 = 15; vt.y1 = 27; vt100_print_text_P(&vt, (char *)pStr_USER_CHG_TEMP);
-    vt.x1 = 16; vt.y1 = 27; vt100_print_text_P(&vt, (char *)pStr_USER_CHG_OCD);
-    vt.x1 = 23; vt.y1 = 2; vt.x2 = 26; vt.y2 = 70; vt100_draw_box(&vt);
-}
+uint8_t hist_buf[HIST_RING_SIZE];
+vt100_ring_t hist_q;
+uint32_t late_us;       // worst delay of a sample behind its deadline
+
+uint16_t hist_v[CEL_COUNT][BMS_TREND_W];
+uint8_t hist_min[CEL_COUNT][BMS_TREND_W];
+uint8_t hist_max[CEL_COUNT][BMS_TREND_W];
+vt100_series_t hist[CEL_COUNT];
+uint8_t trend_cell;     // picked with Up and Down
+
+#define MUX_CLIENTS 16
+
+vt100_mux_t mux;        // further terminals watching the same screen, -m
+bool mux_on;
 
-void Print_Values() {
+// Only the render tick of the scheduler is used here: Sampler keeps its
+// own deadlines on a thread. The timer wheel is for the MCU build, where
+// sampling has no thread to run on.
+vt100_sched_t sched;
+
+void Sample_Cells(uint32_t n) {
+    bms_sample_t s;
     for (uint8_t i = 0; i < CEL_COUNT; i++) {
-        vt100_pos_x_y(&vt, 7+i, 4);  fprintf_P(vt.f, PSTR("%u"), i+1);
-        vt100_pos_x_y(&vt, 7+i, 9);  fprintf_P(vt.f, PSTR("%u"), cells_mv[i]);
-        vt100_pos_x_y(&vt, 7+i, 18); fprintf_P(vt.f, PSTR("%1u.%03u"), cells_mv[i]/1000, cells_mv[i]%1000);
+        cells_mv[i] += rand()/100000000;
+        cells_mv[i] -= rand()/100000000;
+    }
+    // A record must go in whole or not at all
+    if (vt100_ring_free(&hist_q) < HIST_REC) hist_q.overflow++;
+    else vt100_ring_write(&hist_q, (uint8_t *)cells_mv, HIST_REC);
+    memcpy(s.cells_mv, cells_mv, sizeof(s.cells_mv));
+    s.uptime_s = n * SAMPLE_MS / 1000;
+    vt100_snap_write(&sample_snap, &s);
+    Wake();
+}
+
+// Absolute deadlines, a late sample does not push the later ones back.
+void *Sampler(void *arg) {
+    struct timespec next, now;
+    uint32_t n = 0, late;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (1) {
+        Sample_Cells(n++);
+        next.tv_nsec += SAMPLE_MS * 1000000L;
+        if (next.tv_nsec >= 1000000000L) { next.tv_nsec -= 1000000000L; next.tv_sec++; }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) ;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        late = (now.tv_sec - next.tv_sec) * 1000000L + (now.tv_nsec - next.tv_nsec) / 1000;
+        if (late > late_us) late_us = late;
+    }
+    return NULL;
+}
+
+void *Input(void *arg) {
+    struct pollfd p = { STDIN_FILENO, POLLIN, 0 };
+    uint8_t chunk[64];
+    ssize_t n;
+    while (1) {
+        if (poll(&p, 1, -1) == -1 && errno != EINTR) die("poll");
+        n = read(STDIN_FILENO, chunk, sizeof(chunk));
+        if (n == -1 && errno != EAGAIN) die("read");
+        if (n <= 0) continue;
+        if (session_on) vt100_rec_put(&session, VT100_REC_IN, chunk, n);
+        read_us = Now_us();
+        vt100_parse(&kbd, chunk, n, Key_Event, NULL);
+        Wake();
     }
+    return NULL;
+}
+
+// Takes the newest snapshot and whatever history came in since the last.
+void Take_Samples() {
+    uint16_t mv[CEL_COUNT];
+    if (vt100_snap_version(&sample_snap) == sample_seen) return;
+    sample_seen = vt100_snap_read(&sample_snap, &sample);
+    while (vt100_ring_read(&hist_q, (uint8_t *)mv, HIST_REC) == HIST_REC)
+        for (uint8_t i = 0; i < CEL_COUNT; i++) vt100_series_push(&hist[i], mv[i]);
+    vt100_sched_dirty(&sched);
+}
+
+void Print_Small() {
+    vt.x1 = 1; vt.y1 = 1; vt100_print_text_P(&vt, PSTR("Terminal too small for the BMS screen"));
+    vt100_flush(&vt);
+}
+
+// Cold start: the precompiled background when one matches the caps and
+// the size, the library otherwise. Either way back holds the background
+// afterwards.
+void Redraw(uint8_t rows, uint8_t cols) {
+    const uint8_t *blob = NULL;
+    uint16_t len = 0;
+    uint8_t caps = vt.caps & ~VT100_CAP_SYNC;   // only frames the output
+    if (caps == BMS_BLOB_PLAIN_CAPS) { blob = bms_blob_plain; len = BMS_BLOB_PLAIN_LEN; }
+    if (caps == BMS_BLOB_DEC_CAPS)   { blob = bms_blob_dec;   len = BMS_BLOB_DEC_LEN; }
+    if (rows != BMS_ROWS || cols != BMS_COLS) blob = NULL;
+    vt100_shadow(&vt, scr_front, scr_back, rows, cols);
+    fits = Bms_Layout(rows, cols);
+    if (!fits) {
+        vt100_begin(&vt);
+        Print_Small();
+        return;
+    }
+    vt100_log_move(&klog, bms_box[BMS_BOX_LOG_TEXT].x1, bms_box[BMS_BOX_LOG_TEXT].y1,
+                   bms_box[BMS_BOX_LOG_TEXT].x2, bms_box[BMS_BOX_LOG_TEXT].y2);
+    if (blob == NULL) {
+        vt100_begin(&vt);
+        Print_Background(&vt);
+        vt100_log_draw(&klog, &vt);
+        vt100_flush(&vt);
+        return;
+    }
+    Print_Background(&vt);  // only fills back
+    vt100_commit(&vt);
+    vt100_out_data_P(&vt.out, blob, len);
+    vt100_log_draw(&klog, &vt);
+}
+
+bool stats_on;      // F2, counters of the last frame over the alarm flags
+bool help_on;       // F1, the keys over the cell table
+vt100_win_t stats_win, help_win;
+vt100_cell_t stats_save[VT100_WIN_CELLS(1, 1, BMS_STATS_ROWS, BMS_STATS_COLS)];
+vt100_cell_t help_save[VT100_WIN_CELLS(1, 1, BMS_HELP_ROWS, BMS_HELP_COLS)];
+
+// Opens or closes a popup, the screen below keeps drawing either way.
+void Toggle_Win(vt100_win_t *w, vt100_cell_t *save, bool on, uint8_t box) {
+    if (!on) {
+        vt100_win_close(&vt, w);
+        return;
+    }
+    Bms_Box(&vt, box);
+    vt100_win_open(&vt, w, save);
+    if (w == &help_win) Print_Help(&vt);
+    vt100_win_select(&vt, NULL);
+}
+
+// The layout again for a new size and all of it drawn into back, the
+// flush sends what moved. Popups open again at their new place.
+void Resize(uint8_t rows, uint8_t cols) {
+    if (rows > BMS_ROWS_MAX) rows = BMS_ROWS_MAX;
+    if (cols > BMS_COLS_MAX) cols = BMS_COLS_MAX;
+    if (rows == vt.rows && cols == vt.cols) return;
+    vt100_resize(&vt, rows, cols);
+    if (mux_on) vt100_mux_resize(&mux);
+    vt100_sched_dirty(&sched);
+    if (!(fits = Bms_Layout(rows, cols))) {
+        Print_Small();
+        return;
+    }
+    vt100_log_move(&klog, bms_box[BMS_BOX_LOG_TEXT].x1, bms_box[BMS_BOX_LOG_TEXT].y1,
+                   bms_box[BMS_BOX_LOG_TEXT].x2, bms_box[BMS_BOX_LOG_TEXT].y2);
+    Print_Background(&vt);
+    vt100_log_draw(&klog, &vt);
+    if (help_on) Toggle_Win(&help_win, help_save, true, BMS_BOX_HELP);
+    if (stats_on) Toggle_Win(&stats_win, stats_save, true, BMS_BOX_STATS);
+}
+
+// The tty driver knows the size of a terminal window. A serial line says
+// 0 x 0, the terminal is asked then and its answer comes as KBD_BTN_CPR.
+volatile sig_atomic_t winch;
+bool ask_size;          // -q, ask the terminal even if the driver knows
+
+void Winch(int sig) {
+    winch = 1;
+    Wake();
+}
+
+bool Term_Size(uint8_t *rows, uint8_t *cols) {
+    struct winsize ws;
+    if (ask_size || ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_row == 0 || ws.ws_col == 0) {
+        vt100_query_size(&vt);
+        return false;
+    }
+    *rows = ws.ws_row > BMS_ROWS_MAX ? BMS_ROWS_MAX : ws.ws_row;
+    *cols = ws.ws_col > BMS_COLS_MAX ? BMS_COLS_MAX : ws.ws_col;
+    return true;
+}
+
+void Render(void *ctx) {
+    if (!vt100_tx_frame(&tx, &vt)) {    // the next diff covers this frame too
+        vt100_sched_dirty(&sched);
+        return;
+    }
+    vt100_stats_begin(&vt, Now_us());
+    vt100_frame_begin(&vt);
+    if (stats_on && fits) {
+        vt100_win_select(&vt, &stats_win);
+        Bms_Box(&vt, BMS_BOX_STATS);
+        vt100_draw_stats(&vt);
+        vt100_win_select(&vt, NULL);
+    }
+    if (fits) {
+        Print_Trend(&vt, &hist[trend_cell], trend_cell);
+        Print_Values(&vt, sample.cells_mv, sample.uptime_s);
+    }
+    vt100_frame_end(&vt);
+    if (vt.behind) vt100_sched_dirty(&sched);   // the link budget ran out
+    if (mux_on) {
+        vt100_mux_flush(&mux);
+        if (vt100_mux_busy(&mux)) vt100_sched_dirty(&sched);
+    }
+    vt100_stats_end(&vt, Now_us());
 }
 
 int main(int argc, char **argv) {
-    enableRawMode();
+    uint8_t key[KEY_REC], drain[64];
+    pthread_t sampler, input, transmit;
+    int opt, fps = FPS_DEFAULT;
+    long baud = 0;
+    uint8_t rows = BMS_ROWS, cols = BMS_COLS;
+    struct sigaction sa;
+    const char *mux_at = NULL, *rec_at = NULL;
 
     vt100_init(&vt);
-    vt100_begin(&vt);
-    Print_Background();
-
-    while (1) {
-        for (uint8_t i = 0; i < CEL_COUNT; i++) {
-            cells_mv[i] += rand()/100000000;
-            cells_mv[i] -= rand()/100000000;
+    while ((opt = getopt(argc, argv, "drsqf:b:m:w:")) != -1) {
+        switch (opt) {
+            case 'd': vt.caps |= VT100_CAP_DEC_LINES; break;
+            case 'r': vt.caps |= VT100_CAP_REP;       break;
+            case 's': vt.caps |= VT100_CAP_SYNC;      break;
+            case 'q': ask_size = true;                break;
+            case 'f': fps = atoi(optarg);             break;
+            case 'b': baud = atol(optarg);            break;
+            case 'm': mux_at = optarg;                break;
+            case 'w': rec_at = optarg;                break;
+            default:
+                fprintf(stderr, "usage: %s [-d] [-r] [-s] [-q] [-f fps] [-b baud] [-m path|port] [-w file]\n"
+                                "  -d  draw lines with DEC Special Graphics\n"
+                                "  -r  terminal supports REP (ESC[nb)\n"
+                                "  -s  terminal supports synchronized updates (ESC[?2026h)\n"
+                                "  -q  ask the terminal for its size, as over a serial line\n"
+                                "  -f  redraw at most fps times a second, 0 = on every change\n"
+                                "  -b  link speed, limits each frame to what it carries\n"
+                                "  -m  also serve the screen on a Unix socket or a localhost TCP port\n"
+                                "  -w  record the session for vt100_replay\n", argv[0]);
+                exit(1);
         }
+    }
+    enableRawMode();
+    vt100_tx_init(&tx, tx_buf, sizeof(tx_buf), Tx_Kick, Tx_Wait, NULL);
+    if (pthread_create(&transmit, NULL, Transmit, NULL) != 0) die("pthread_create");
+
+    vt100_ring_init(&keys, key_buf, sizeof(key_buf));
+    vt100_parser_init(&kbd);
+    if (rec_at) {
+        if (!vt100_rec_open(&session, rec_at, vt100_tx_sink, &tx)) die(rec_at);
+        session_on = true;
+    }
+    vt100_out_init(&vt.out, out_buf, sizeof(out_buf), session_on ? vt100_rec_sink : vt100_tx_sink,
+                  session_on ? (void *)&session : (void *)&tx);
+    vt100_regions(&vt, bms_regions, BMS_REGION_COUNT);
+    vt100_link(&vt, baud / 10, fps);    // 8N1, ten bits a byte
+    vt100_log_init(&klog, log_buf, LOG_LINES, 1, 1, 1, BMS_LOG_COLS_MAX);
+    Term_Size(&rows, &cols);    // until the terminal answers, it is BMS_ROWS x BMS_COLS
+    Redraw(rows, cols);
+    vt100_paste_mode(&vt, true);
+    vt100_out_flush(&vt.out);
+
+    if (mux_at) {
+        if (!vt100_mux_init(&mux, &vt, MUX_CLIENTS, vt.caps)) die("vt100_mux_init");
+        if ((isdigit((uint8_t)mux_at[0]) ? vt100_mux_listen_tcp(&mux, atoi(mux_at))
+                                         : vt100_mux_listen_unix(&mux, mux_at)) < 0) die(mux_at);
+        mux_on = true;
+    }
 
-        if (read(STDIN_FILENO, &UDR0, 1) == -1 && errno != EAGAIN) die("read");
-        if (UDR0) UDR_INT();
-        UDR0 = 0;
-
-        Print_Pressed_Decoder(Keyboard_Pressed);
+    for (uint8_t i = 0; i < CEL_COUNT; i++) {
+        vt100_series_init(&hist[i], hist_v[i], hist_min[i], hist_max[i], BMS_TREND_W);
+        hist[i].lo = BMS_TREND_LO;
+        hist[i].hi = BMS_TREND_HI;
+    }
+    memcpy(sample.cells_mv, cells_mv, sizeof(sample.cells_mv));
+    vt100_ring_init(&hist_q, hist_buf, sizeof(hist_buf));
+    vt100_snap_init(&sample_snap, &sample_pub, sizeof(sample_pub));
+    vt100_sched_init(&sched, TICK_MS);
+    vt100_sched_render(&sched, fps, Render, NULL);
+
+    if (pipe(wake) == -1) die("pipe");
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake[1], F_SETFL, O_NONBLOCK);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = Winch;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &sa, NULL);
+    if (pthread_create(&sampler, NULL, Sampler, NULL) != 0) die("pthread_create");
+    if (pthread_create(&input, NULL, Input, NULL) != 0) die("pthread_create");
 
-        if (Keyboard_Pressed == KBD_BTN_CTRL_C) {
+    while (1) {
+        if (vt100_sched_wait(&sched, wake[0])) while (read(wake[0], drain, sizeof(drain)) > 0) ;
 
+        if (winch) {
+            winch = 0;
+            if (Term_Size(&rows, &cols)) Resize(rows, cols);
+        }
+        if (mux_on && vt100_mux_poll(&mux)) vt100_sched_dirty(&sched);
+        Take_Samples();
+
+        if (vt100_ring_count(&keys)) vt100_sched_dirty(&sched);
+        while (vt100_ring_read(&keys, key, KEY_REC) == KEY_REC) {
+            vt100_stats_key(&vt, Now_us() - (key[5] | key[6] << 8 | (uint32_t)key[7] << 16 | (uint32_t)key[8] << 24));
+            Print_Pressed_Decoder(key[0], key[1], key[2], key[3] | key[4] << 8);
+            if (key[0] == KBD_BTN_CPR) Resize(key[3], key[4]);
+            if (key[0] == KBD_BTN_KEY_F1 && fits) Toggle_Win(&help_win, help_save, help_on = !help_on, BMS_BOX_HELP);
+            if (key[0] == KBD_BTN_KEY_F2 && fits) Toggle_Win(&stats_win, stats_save, stats_on = !stats_on, BMS_BOX_STATS);
+            if (key[0] == KBD_BTN_KEY_UP && trend_cell > 0) trend_cell--;
+            if (key[0] == KBD_BTN_KEY_DOWN && trend_cell < CEL_COUNT - 1) trend_cell++;
+            if (key[0] == KBD_BTN_KEY_PG_UP && fits) vt100_log_scroll(&klog, &vt, klog.x2 - klog.x1 + 1);
+            if (key[0] == KBD_BTN_KEY_PG_DN && fits) vt100_log_scroll(&klog, &vt, klog.x1 - klog.x2 - 1);
+            if (key[0] != KBD_BTN_CTRL_C) continue;
+
+            if (mux_on) vt100_mux_close(&mux);
+            vt100_paste_mode(&vt, false);
             vt100_end(&vt);
 
-            printf_P(PSTR("CTRL + C, Bye!\r\n"));
+            vt100_out_str_P(&vt.out, PSTR("Cursor moves: "));
+            vt100_out_u32(&vt.out, vt.move_bytes);
+            vt100_out_str_P(&vt.out, PSTR(" bytes, "));
+            vt100_out_u32(&vt.out, vt.move_cup_bytes);
+            vt100_out_str_P(&vt.out, PSTR(" with absolute CUP\r\n"));
+            vt100_out_str_P(&vt.out, PSTR("Overflow: keys "));
+            vt100_out_u16(&vt.out, keys.overflow);
+            vt100_out_str_P(&vt.out, PSTR(", history "));
+            vt100_out_u16(&vt.out, hist_q.overflow);
+            vt100_out_str_P(&vt.out, PSTR("\r\n"));
+            vt100_out_str_P(&vt.out, PSTR("Frames: "));
+            vt100_out_u32(&vt.out, vt.stats.frames);
+            vt100_out_str_P(&vt.out, PSTR(", up to "));
+            vt100_out_u16(&vt.out, vt.stats.bytes_max);
+            vt100_out_str_P(&vt.out, PSTR(" bytes and "));
+            vt100_out_u32(&vt.out, vt.stats.render_us_max);
+            vt100_out_str_P(&vt.out, PSTR(" us, keys handled within "));
+            vt100_out_u32(&vt.out, vt.stats.key_us_max);
+            vt100_out_str_P(&vt.out, PSTR(" us\r\n"));
+            vt100_out_str_P(&vt.out, PSTR("Transmit: "));
+            vt100_out_u32(&vt.out, tx.skipped);
+            vt100_out_str_P(&vt.out, PSTR(" frames skipped, "));
+            vt100_out_u32(&vt.out, tx.stalls);
+            vt100_out_str_P(&vt.out, PSTR(" stalls, up to "));
+            vt100_out_u32(&vt.out, tx.backlog_max);
+            vt100_out_str_P(&vt.out, PSTR(" bytes queued\r\n"));
+            vt100_out_str_P(&vt.out, PSTR("Samples late by up to "));
+            vt100_out_u32(&vt.out, late_us);
+            vt100_out_str_P(&vt.out, PSTR(" us\r\n"));
+            vt100_out_str_P(&vt.out, PSTR("CTRL + C, Bye!\r\n"));
+            vt100_out_flush(&vt.out);
+            if (session_on) vt100_rec_close(&session);
+            Tx_Drain();
             exit(0);
         }
-        Keyboard_Pressed = KBD_BTN_NULL;
-        Print_Values();
+        vt100_sched_run(&sched);
     }
     return 0;
 }
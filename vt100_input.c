@@ -0,0 +1,285 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "vt100_input.h"
+#include "vt100_out.h"
+#include <string.h>
+
+// States and byte classes of a DEC style (Paul Williams) input parser,
+// trimmed to what keyboards send. Every table entry is action << 4 | state.
+
+enum { S_GROUND, S_ESC, S_CSI, S_CSI_INTER, S_CSI_IGNORE, S_SS3 };
+
+enum { C_CTRL, C_ESC, C_INTER, C_DIGIT, C_SEP, C_PRIV, C_FINAL, C_CSI, C_SS3, C_DEL, C_HIGH, C_COUNT };
+
+enum {
+    A_NONE,
+    A_KEY,      // plain byte in ground state
+    A_CLEAR,    // ESC seen, forget the last sequence
+    A_PARAM,
+    A_SEP,
+    A_INTER,
+    A_ESC,      // ESC followed by anything but [ or O
+    A_CSI,
+    A_SS3,
+    A_IGNORED   // malformed sequence ended
+};
+
+#define E(a, s) (((a) << 4) | (s))
+
+static const uint8_t vt100_parse_table[][C_COUNT] PROGMEM = {
+    [S_GROUND] = {
+        E(A_KEY, S_GROUND),   E(A_CLEAR, S_ESC),    E(A_KEY, S_GROUND),     E(A_KEY, S_GROUND),
+        E(A_KEY, S_GROUND),   E(A_KEY, S_GROUND),   E(A_KEY, S_GROUND),     E(A_KEY, S_GROUND),
+        E(A_KEY, S_GROUND),   E(A_KEY, S_GROUND),   E(A_KEY, S_GROUND)
+    },
+    [S_ESC] = {
+        E(A_ESC, S_GROUND),   E(A_ESC, S_GROUND),   E(A_ESC, S_GROUND),     E(A_ESC, S_GROUND),
+        E(A_ESC, S_GROUND),   E(A_ESC, S_GROUND),   E(A_ESC, S_GROUND),     E(A_NONE, S_CSI),
+        E(A_NONE, S_SS3),     E(A_ESC, S_GROUND),   E(A_ESC, S_GROUND)
+    },
+    [S_CSI] = {
+        E(A_KEY, S_CSI),      E(A_CLEAR, S_ESC),    E(A_INTER, S_CSI_INTER), E(A_PARAM, S_CSI),
+        E(A_SEP, S_CSI),      E(A_INTER, S_CSI),    E(A_CSI, S_GROUND),     E(A_CSI, S_GROUND),
+        E(A_CSI, S_GROUND),   E(A_NONE, S_CSI),     E(A_NONE, S_CSI_IGNORE)
+    },
+    [S_CSI_INTER] = {
+        E(A_KEY, S_CSI_INTER), E(A_CLEAR, S_ESC),   E(A_INTER, S_CSI_INTER), E(A_NONE, S_CSI_IGNORE),
+        E(A_NONE, S_CSI_IGNORE), E(A_NONE, S_CSI_IGNORE), E(A_CSI, S_GROUND), E(A_CSI, S_GROUND),
+        E(A_CSI, S_GROUND),   E(A_NONE, S_CSI_INTER), E(A_NONE, S_CSI_IGNORE)
+    },
+    [S_CSI_IGNORE] = {
+        E(A_NONE, S_CSI_IGNORE), E(A_CLEAR, S_ESC), E(A_NONE, S_CSI_IGNORE), E(A_NONE, S_CSI_IGNORE),
+        E(A_NONE, S_CSI_IGNORE), E(A_NONE, S_CSI_IGNORE), E(A_IGNORED, S_GROUND), E(A_IGNORED, S_GROUND),
+        E(A_IGNORED, S_GROUND), E(A_NONE, S_CSI_IGNORE), E(A_NONE, S_CSI_IGNORE)
+    },
+    [S_SS3] = {
+        E(A_KEY, S_GROUND),   E(A_CLEAR, S_ESC),    E(A_IGNORED, S_GROUND), E(A_PARAM, S_SS3),
+        E(A_IGNORED, S_GROUND), E(A_IGNORED, S_GROUND), E(A_SS3, S_GROUND), E(A_SS3, S_GROUND),
+        E(A_SS3, S_GROUND),   E(A_NONE, S_SS3),     E(A_IGNORED, S_GROUND)
+    }
+};
+
+static uint8_t vt100_byte_class(uint8_t c) {
+    if (c == 0x1B) return C_ESC;
+    if (c < 0x20)  return C_CTRL;
+    if (c < 0x30)  return C_INTER;
+    if (c < 0x3A)  return C_DIGIT;
+    if (c < 0x3C)  return C_SEP;
+    if (c < 0x40)  return C_PRIV;
+    if (c == '[')  return C_CSI;
+    if (c == 'O')  return C_SS3;
+    if (c < 0x7F)  return C_FINAL;
+    if (c == 0x7F) return C_DEL;
+    return C_HIGH;
+}
+
+typedef struct {
+    uint8_t code;
+    uint8_t key;
+} vt100_key_map_t;
+
+// Finals of CSI and SS3 sequences, ESC[A and ESCOA alike
+static const vt100_key_map_t vt100_final_keys[] PROGMEM = {
+    { 'A', KBD_BTN_KEY_UP },    { 'B', KBD_BTN_KEY_DOWN },  { 'C', KBD_BTN_KEY_RIGHT },
+    { 'D', KBD_BTN_KEY_LEFT },  { 'H', KBD_BTN_KEY_HOME },  { 'F', KBD_BTN_KEY_END },
+    { 'P', KBD_BTN_KEY_F1 },    { 'Q', KBD_BTN_KEY_F2 },    { 'R', KBD_BTN_KEY_F3 },
+    { 'S', KBD_BTN_KEY_F4 },    { 'M', KBD_BTN_KEY_ENTER }, { 'Z', KBD_BTN_KEY_TAB },
+    { 0, 0 }
+};
+
+// First parameter of ESC[n~ sequences
+static const vt100_key_map_t vt100_tilde_keys[] PROGMEM = {
+    { 1, KBD_BTN_KEY_HOME },    { 2, KBD_BTN_KEY_INSERT },  { 3, KBD_BTN_KEY_DELETE },
+    { 4, KBD_BTN_KEY_END },     { 5, KBD_BTN_KEY_PG_UP },   { 6, KBD_BTN_KEY_PG_DN },
+    { 7, KBD_BTN_KEY_HOME },    { 8, KBD_BTN_KEY_END },     { 11, KBD_BTN_KEY_F1 },
+    { 12, KBD_BTN_KEY_F2 },     { 13, KBD_BTN_KEY_F3 },     { 14, KBD_BTN_KEY_F4 },
+    { 15, KBD_BTN_KEY_F5 },     { 17, KBD_BTN_KEY_F6 },     { 18, KBD_BTN_KEY_F7 },
+    { 19, KBD_BTN_KEY_F8 },     { 20, KBD_BTN_KEY_F9 },     { 21, KBD_BTN_KEY_F10 },
+    { 23, KBD_BTN_KEY_F11 },    { 24, KBD_BTN_KEY_F12 },    { 200, KBD_BTN_PASTE },
+    { 0, 0 }
+};
+
+// Kept in RAM, false terminator starts are handed to the callback from here
+static const uint8_t paste_end[] = { 0x1B, '[', '2', '0', '1', '~' };
+
+static uint8_t vt100_key_lookup(const vt100_key_map_t *map, uint16_t code) {
+    uint8_t c;
+    for (; (c = pgm_read_byte(&map->code)) != 0; map++) {
+        if (c == code) return pgm_read_byte(&map->key);
+    }
+    return KBD_BTN_UNKNOWN;
+}
+
+void vt100_parser_init(vt100_parser_t *p) {
+    memset(p, 0, sizeof(*p));
+}
+
+static void vt100_parse_clear(vt100_parser_t *p) {
+    p->nparams = 0;
+    p->inter = 0;
+    memset(p->params, 0, sizeof(p->params));
+}
+
+static void vt100_parse_key(vt100_parser_t *p, uint8_t c, vt100_key_event_t *ev) {
+    switch (c) {
+        case 0x03: ev->key = KBD_BTN_CTRL_C;        break;
+        case 0x09: ev->key = KBD_BTN_KEY_TAB;       break;
+        case 0x0D: ev->key = KBD_BTN_KEY_ENTER;     break;
+        case 0x08:
+        case 0x7F: ev->key = KBD_BTN_KEY_BACKSPACE; break;
+        default:
+            ev->key = KBD_BTN_CHAR;
+            ev->ch = c;
+            if (c < 0x20) { ev->ch = c + 0x60; ev->mods |= VT100_MOD_CTRL; }
+    }
+}
+
+// Modifier parameter n (1-based) as VT100_MOD_* bits
+static uint8_t vt100_parse_mods(vt100_parser_t *p, uint8_t n) {
+    if (p->nparams < n || p->params[n - 1] < 2) return 0;
+    return (p->params[n - 1] - 1) & 0x0F;
+}
+
+static void vt100_parse_csi(vt100_parser_t *p, uint8_t c, vt100_key_event_t *ev) {
+    if (p->nparams < VT100_PARAM_MAX) p->nparams++;
+    if (p->inter) {
+        ev->key = KBD_BTN_UNKNOWN;
+    } else if (c == 'R' && p->nparams == 2 && p->params[0] > 1) {
+        // Shift+F3 and the like are ESC[1;nR, a cursor report past row 1
+        // can not be one of them
+        ev->key = KBD_BTN_CPR;
+        ev->x = p->params[0] > 255 ? 255 : p->params[0];
+        ev->y = p->params[1] > 255 ? 255 : p->params[1];
+    } else if (c == '~') {
+        ev->key = vt100_key_lookup(vt100_tilde_keys, p->params[0]);
+        ev->mods = vt100_parse_mods(p, 2);
+    } else {
+        ev->key = vt100_key_lookup(vt100_final_keys, c);
+        ev->mods = vt100_parse_mods(p, 2);
+        if (c == 'Z') ev->mods |= VT100_MOD_SHIFT;
+    }
+    ev->final = c;
+}
+
+static void vt100_paste_chunk(vt100_key_cb_t cb, void *ctx, const uint8_t *data, uint16_t len, uint16_t *events) {
+    vt100_key_event_t ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.key = len ? KBD_BTN_PASTE : KBD_BTN_PASTE_END;
+    ev.data = data;
+    ev.len = len;
+    cb(ctx, &ev);
+    (*events)++;
+}
+
+// Passes pasted bytes through untouched until ESC[201~. Terminator bytes
+// carried over from the previous call are given out again from paste_end
+// if they turn out to be paste data after all.
+static uint16_t vt100_parse_paste(vt100_parser_t *p, const uint8_t *buf, uint16_t len,
+                                  vt100_key_cb_t cb, void *ctx, uint16_t *events) {
+    uint16_t n = 0, chunk;
+    uint8_t carried = p->paste_match;
+    while (n < len) {
+        if (buf[n] == paste_end[p->paste_match]) {
+            n++;
+            if (++p->paste_match < sizeof(paste_end)) continue;
+            chunk = n - (sizeof(paste_end) - carried);
+            if (chunk) vt100_paste_chunk(cb, ctx, buf, chunk, events);
+            vt100_paste_chunk(cb, ctx, NULL, 0, events);
+            p->paste = false;
+            p->paste_match = 0;
+            return n;
+        }
+        if (p->paste_match) {
+            if (carried) vt100_paste_chunk(cb, ctx, paste_end, carried, events);
+            carried = 0;
+            p->paste_match = 0;
+            continue;
+        }
+        n++;
+    }
+    chunk = n - (p->paste_match - carried);
+    if (chunk) vt100_paste_chunk(cb, ctx, buf, chunk, events);
+    return n;
+}
+
+// Decodes a whole buffer, calling cb once per key. Sequences may be split
+// across calls. Returns the number of events delivered.
+uint16_t vt100_parse(vt100_parser_t *p, const uint8_t *buf, uint16_t len, vt100_key_cb_t cb, void *ctx) {
+    vt100_key_event_t ev;
+    uint16_t n = 0, events = 0;
+    uint8_t c, e;
+    while (n < len) {
+        if (p->paste) {
+            n += vt100_parse_paste(p, buf + n, len - n, cb, ctx, &events);
+            continue;
+        }
+        c = buf[n++];
+        e = pgm_read_byte(&vt100_parse_table[p->state][vt100_byte_class(c)]);
+        p->state = e & 0x0F;
+        memset(&ev, 0, sizeof(ev));
+        switch (e >> 4) {
+            case A_NONE:
+                continue;
+            case A_KEY:
+                vt100_parse_key(p, c, &ev);
+                break;
+            case A_CLEAR:
+                vt100_parse_clear(p);
+                continue;
+            case A_PARAM:
+                if (p->nparams < VT100_PARAM_MAX && p->params[p->nparams] < 6553) {
+                    p->params[p->nparams] = p->params[p->nparams] * 10 + (c - '0');
+                }
+                continue;
+            case A_SEP:
+                if (p->nparams < VT100_PARAM_MAX) p->nparams++;
+                continue;
+            case A_INTER:
+                p->inter = c;
+                continue;
+            case A_ESC:
+                if (c == 0x1B) { ev.key = KBD_BTN_KEY_ESC; break; }
+                vt100_parse_key(p, c, &ev);
+                ev.mods |= VT100_MOD_ALT;
+                break;
+            case A_CSI:
+                vt100_parse_csi(p, c, &ev);
+                if (ev.key == KBD_BTN_PASTE) { p->paste = true; continue; }
+                break;
+            case A_SS3:
+                if (p->nparams < VT100_PARAM_MAX) p->nparams++;
+                ev.key = vt100_key_lookup(vt100_final_keys, c);
+                ev.mods = vt100_parse_mods(p, 1);
+                ev.final = c;
+                break;
+            default:
+                ev.key = KBD_BTN_UNKNOWN;
+                ev.final = c;
+        }
+        cb(ctx, &ev);
+        events++;
+    }
+    return events;
+}
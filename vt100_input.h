@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum  {
+    KBD_BTN_NULL        = 0,
+    KBD_BTN_KEY_ENTER,
+    KBD_BTN_KEY_TAB,
+    KBD_BTN_KEY_ESC,
+    KBD_BTN_KEY_BACKSPACE,
+    KBD_BTN_KEY_UP,
+    KBD_BTN_KEY_DOWN,
+    KBD_BTN_KEY_RIGHT,
+    KBD_BTN_KEY_LEFT,
+    KBD_BTN_KEY_F1,
+    KBD_BTN_KEY_F2,
+    KBD_BTN_KEY_F3,
+    KBD_BTN_KEY_F4,
+    KBD_BTN_KEY_HOME,
+    KBD_BTN_KEY_END,
+    KBD_BTN_CTRL_C,
+    KBD_BTN_KEY_INSERT,
+    KBD_BTN_KEY_DELETE,
+    KBD_BTN_KEY_PG_UP,
+    KBD_BTN_KEY_PG_DN,
+    KBD_BTN_KEY_F5,
+    KBD_BTN_KEY_F6,
+    KBD_BTN_KEY_F7,
+    KBD_BTN_KEY_F8,
+    KBD_BTN_KEY_F9,
+    KBD_BTN_KEY_F10,
+    KBD_BTN_KEY_F11,
+    KBD_BTN_KEY_F12,
+    KBD_BTN_CHAR,           // ch holds the byte, Ctrl+letter comes as the letter with VT100_MOD_CTRL
+    KBD_BTN_PASTE,          // data/len hold a chunk of bracketed paste
+    KBD_BTN_PASTE_END,
+    KBD_BTN_CPR,            // x, y hold the cursor position the terminal reported
+    KBD_BTN_UNKNOWN         // well-formed sequence without a key assigned
+} KeyboardButtons;
+
+// Modifier bits, xterm encodes them as parameter value - 1
+#define VT100_MOD_SHIFT 0x01
+#define VT100_MOD_ALT   0x02
+#define VT100_MOD_CTRL  0x04
+#define VT100_MOD_META  0x08
+
+#define VT100_PARAM_MAX 4
+
+typedef struct {
+    uint8_t  key;           // KeyboardButtons
+    uint8_t  mods;
+    uint8_t  ch;
+    uint8_t  final;         // KBD_BTN_UNKNOWN: final byte of the sequence
+    uint8_t  x;             // KBD_BTN_CPR: row
+    uint8_t  y;             // KBD_BTN_CPR: column
+    const uint8_t *data;    // KBD_BTN_PASTE: valid during the callback only
+    uint16_t len;
+} vt100_key_event_t;
+
+typedef void (*vt100_key_cb_t)(void *ctx, const vt100_key_event_t *ev);
+
+typedef struct {
+    uint8_t  state;
+    uint8_t  nparams;
+    uint8_t  inter;         // last intermediate or private marker, 0 if none
+    uint8_t  paste_match;   // bytes of the paste terminator seen so far
+    bool     paste;
+    uint16_t params[VT100_PARAM_MAX];
+} vt100_parser_t;
+
+void vt100_parser_init(vt100_parser_t *p);
+uint16_t vt100_parse(vt100_parser_t *p, const uint8_t *buf, uint16_t len, vt100_key_cb_t cb, void *ctx);
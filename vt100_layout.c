@@ -0,0 +1,66 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "vt100_layout.h"
+#include "vt100_out.h"
+
+// Parents come before their children, so one pass in table order places
+// every node inside a box that is done already. Returns false if the
+// fixed sizes do not fit, box is partly filled then.
+bool vt100_layout(const vt100_lay_t *lay, uint8_t n, vt100_box_t *box, uint8_t rows, uint8_t cols) {
+    uint8_t p, k, pad, split, size, weight;
+    uint16_t len, fixed, weights, left, sum, at, share;
+    box[0].x1 = 1; box[0].y1 = 1; box[0].x2 = rows; box[0].y2 = cols;
+    for (p = 0; p < n; p++) {
+        pad = pgm_read_byte(&lay[p].pad);
+        split = pgm_read_byte(&lay[p].split);
+        len = (split == VT100_LAY_ROWS) ? box[p].x2 - box[p].x1 + 1 : box[p].y2 - box[p].y1 + 1;
+        fixed = weights = 0;
+        for (k = p + 1; k < n; k++) {
+            if (pgm_read_byte(&lay[k].parent) != p) continue;
+            fixed += pgm_read_byte(&lay[k].size);
+            weights += pgm_read_byte(&lay[k].weight);
+        }
+        if (fixed == 0 && weights == 0) continue;
+        if (len < 2 * pad + fixed) return false;
+        left = len - 2 * pad - fixed;
+        at = ((split == VT100_LAY_ROWS) ? box[p].x1 : box[p].y1) + pad;
+        sum = 0;
+        for (k = p + 1; k < n; k++) {
+            if (pgm_read_byte(&lay[k].parent) != p) continue;
+            size = pgm_read_byte(&lay[k].size);
+            weight = pgm_read_byte(&lay[k].weight);
+            // Rounded on the running sum, so the shares add up to left
+            share = weights ? (uint32_t)left * (sum + weight) / weights - (uint32_t)left * sum / weights : 0;
+            sum += weight;
+            box[k].x1 = box[p].x1 + pad; box[k].x2 = box[p].x2 - pad;
+            box[k].y1 = box[p].y1 + pad; box[k].y2 = box[p].y2 - pad;
+            if (split == VT100_LAY_ROWS) { box[k].x1 = at; box[k].x2 = at + size + share - 1; }
+            else                         { box[k].y1 = at; box[k].y2 = at + size + share - 1; }
+            at += size + share;
+        }
+    }
+    return true;
+}
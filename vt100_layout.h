@@ -0,0 +1,55 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Box geometry from the terminal size. A layout is a table of nodes, the
+// first is the whole screen and every other one splits the inside of an
+// earlier node with its siblings: stacked when the parent splits in rows,
+// side by side when it splits in columns. A node gets its size and then
+// a share of what the parent has left by weight, fixed nodes weigh 0.
+
+#define VT100_LAY_ROWS 0    // children one below the other
+#define VT100_LAY_COLS 1    // children next to each other
+
+typedef struct {
+    uint8_t parent;     // index of an earlier node, ignored for the first
+    uint8_t split;      // VT100_LAY_ROWS or VT100_LAY_COLS, for its children
+    uint8_t pad;        // cells kept free inside on every side, 1 for a border
+    uint8_t size;       // rows or columns along the parent's split at least
+    uint8_t weight;
+} vt100_lay_t;
+
+// A box as the x1, y1, x2, y2 of vt100_instance_t
+typedef struct {
+    uint8_t x1;
+    uint8_t y1;
+    uint8_t x2;
+    uint8_t y2;
+} vt100_box_t;
+
+bool vt100_layout(const vt100_lay_t *lay, uint8_t n, vt100_box_t *box, uint8_t rows, uint8_t cols);
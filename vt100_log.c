@@ -0,0 +1,118 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "vt100_log.h"
+
+void vt100_log_init(vt100_log_t *l, char *buf, uint8_t nlines, uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
+    l->lines = buf;
+    l->nlines = nlines;
+    l->width = y2 - y1 + 1;
+    l->head = 0;
+    l->count = 0;
+    l->back = 0;
+    l->x1 = x1;
+    l->y1 = y1;
+    l->x2 = x2;
+    l->y2 = y2;
+}
+
+static uint8_t vt100_log_height(const vt100_log_t *l) {
+    return l->x2 - l->x1 + 1;
+}
+
+// Line 'age' steps before the newest, NULL past the oldest one.
+static char *vt100_log_line(vt100_log_t *l, uint8_t age) {
+    if (age >= l->count) return NULL;
+    return l->lines + (uint16_t)((l->head + l->nlines - 1 - age) % l->nlines) * (l->width + 1);
+}
+
+// A new layout, drawn by the next vt100_log_draw. The panel is never
+// wider than at init, the view follows new lines again.
+void vt100_log_move(vt100_log_t *l, uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
+    if (y2 - y1 + 1 > l->width) y2 = y1 + l->width - 1;
+    l->x1 = x1;
+    l->y1 = y1;
+    l->x2 = x2;
+    l->y2 = y2;
+    l->back = 0;
+}
+
+static void vt100_log_print(vt100_log_t *l, vt100_instance_t *i, uint8_t x, char *line) {
+    char blank[2] = " ", cut;
+    uint8_t w = l->y2 - l->y1 + 1;
+    i->x1 = x;
+    i->y1 = l->y1;
+    if (line) {
+        cut = line[w];
+        line[w] = 0;
+        vt100_print_text(i, line);
+        line[w] = cut;
+        return;
+    }
+    for (; i->y1 <= l->y2; i->y1++) vt100_print_text(i, blank);
+}
+
+// Stored lines are padded to the width, printing one clears the old text.
+void vt100_log_add(vt100_log_t *l, vt100_instance_t *i, const char *txt) {
+    char *line = l->lines + (uint16_t)l->head * (l->width + 1);
+    uint8_t n = 0;
+    while (n < l->width && txt[n]) { line[n] = txt[n]; n++; }
+    memset(line + n, ' ', l->width - n);
+    line[l->width] = 0;
+    l->head = (l->head + 1) % l->nlines;
+    if (l->count < l->nlines) l->count++;
+    if (i->behind && !l->back) {
+        // The line is busy, a hardware scroll would queue behind it. Into
+        // the shadow instead, the flush sends the lines when there is room.
+        vt100_log_draw(l, i);
+        return;
+    }
+    if (l->back) {
+        // Keep the view still while the user reads older lines.
+        if (l->back < l->count - vt100_log_height(l)) l->back++;
+        else vt100_log_draw(l, i);
+        return;
+    }
+    i->x1 = l->x1; i->y1 = l->y1; i->x2 = l->x2; i->y2 = l->y2;
+    vt100_scroll_up(i);
+    vt100_log_print(l, i, l->x2, line);
+}
+
+// Positive lines go back in time, clamped to the oldest full page.
+void vt100_log_scroll(vt100_log_t *l, vt100_instance_t *i, int8_t lines) {
+    int16_t back = (int16_t)l->back + lines;
+    int16_t top = (int16_t)l->count - vt100_log_height(l);
+    if (back > top) back = top;
+    if (back < 0) back = 0;
+    if (back == l->back) return;
+    l->back = back;
+    vt100_log_draw(l, i);
+}
+
+void vt100_log_draw(vt100_log_t *l, vt100_instance_t *i) {
+    uint8_t x;
+    for (x = l->x1; x <= l->x2; x++)
+        vt100_log_print(l, i, x, vt100_log_line(l, l->back + (l->x2 - x)));
+}
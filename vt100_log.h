@@ -0,0 +1,55 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "vt100_print.h"
+
+// Event log panel in a box of the screen. New lines enter at the bottom
+// through vt100_scroll_up, so an append costs the scroll plus the line and
+// not a repaint of the panel. The last nlines lines stay in a ring for
+// scrolling back, lines are ASCII and cut to the panel width. A panel
+// that moves keeps its lines, they show as wide as the panel at init.
+
+typedef struct {
+    char    *lines;     // nlines slots of width + 1 bytes, slot head is the next one
+    uint8_t nlines;
+    uint8_t width;
+    uint8_t head;
+    uint8_t count;      // lines in the ring
+    uint8_t back;       // lines scrolled back, 0 follows new ones
+    uint8_t x1;         // panel inside the screen, as vt100_instance_t
+    uint8_t y1;
+    uint8_t x2;
+    uint8_t y2;
+} vt100_log_t;
+
+#define VT100_LOG_BUF(nlines, y1, y2) ((nlines) * ((y2) - (y1) + 2))
+
+void vt100_log_init(vt100_log_t *l, char *buf, uint8_t nlines, uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
+void vt100_log_move(vt100_log_t *l, uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
+void vt100_log_add(vt100_log_t *l, vt100_instance_t *i, const char *txt);
+void vt100_log_scroll(vt100_log_t *l, vt100_instance_t *i, int8_t lines);
+void vt100_log_draw(vt100_log_t *l, vt100_instance_t *i);
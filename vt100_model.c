@@ -0,0 +1,348 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "vt100_model.h"
+
+enum { M_GROUND, M_ESC, M_CSI, M_G0 };
+
+// Field by field, vt100_cell_t has a padding byte.
+static bool vt100_model_eq(const vt100_cell_t *a, const vt100_cell_t *b) {
+    return a->ch == b->ch && a->a.fg == b->a.fg && a->a.bg == b->a.bg && a->a.modes == b->a.modes;
+}
+
+static void vt100_model_blank(vt100_model_t *m, uint16_t from, uint16_t to) {
+    vt100_cell_t c, *p;
+    c.ch = ' ';
+    c.a = m->attr;  // erased cells take the current attributes, like vt100_fill
+    for (; from < to; from++) {
+        p = &m->cells[from];
+        if (vt100_model_eq(p, &c)) continue;
+        *p = c;
+        m->changed = true;
+    }
+}
+
+void vt100_model_init(vt100_model_t *m, vt100_cell_t *cells, uint8_t rows, uint8_t cols) {
+    memset(m, 0, sizeof(*m));
+    m->cells = cells;
+    m->rows = rows;
+    m->cols = cols;
+    m->x = 1;
+    m->y = 1;
+    m->top = 1;
+    m->bottom = rows;
+    m->attr.fg = DEFAULT;
+    m->attr.bg = DEFAULT;
+    m->charset = VT100_CS_ASCII;
+    m->cursor_on = true;
+    m->last = ' ';
+    m->save_x = 1;
+    m->save_y = 1;
+    m->save_attr = m->attr;
+    m->save_charset = VT100_CS_ASCII;
+    vt100_model_blank(m, 0, (uint16_t)rows * cols);
+}
+
+// The window changed size, as xterm does it: what both sizes share stays
+// at the top left, new cells are blank in the default colors, the scroll
+// region is the whole screen again. cells must hold rows x cols.
+void vt100_model_resize(vt100_model_t *m, uint8_t rows, uint8_t cols) {
+    vt100_attr_t attr = m->attr;
+    uint8_t keep_r = rows < m->rows ? rows : m->rows, keep_c = cols < m->cols ? cols : m->cols, x;
+    if (cols <= m->cols) {
+        for (x = 0; x < keep_r; x++)
+            memmove(&m->cells[(uint16_t)x * cols], &m->cells[(uint16_t)x * m->cols], keep_c * sizeof(vt100_cell_t));
+    } else {
+        for (x = keep_r; x--; )
+            memmove(&m->cells[(uint16_t)x * cols], &m->cells[(uint16_t)x * m->cols], keep_c * sizeof(vt100_cell_t));
+    }
+    m->attr.fg = DEFAULT;
+    m->attr.bg = DEFAULT;
+    m->attr.modes = 0;
+    for (x = 0; x < keep_r; x++) vt100_model_blank(m, (uint16_t)x * cols + keep_c, (uint16_t)(x + 1) * cols);
+    vt100_model_blank(m, (uint16_t)keep_r * cols, (uint16_t)rows * cols);
+    m->attr = attr;
+    m->rows = rows;
+    m->cols = cols;
+    m->top = 1;
+    m->bottom = rows;
+    if (m->x > rows) m->x = rows;
+    if (m->y > cols) m->y = cols;
+    m->wrap = false;
+}
+
+vt100_cell_t *vt100_model_cell(vt100_model_t *m, uint8_t x, uint8_t y) {
+    if (x < 1 || y < 1 || x > m->rows || y > m->cols) return NULL;
+    return &m->cells[(uint16_t)(x - 1) * m->cols + (y - 1)];
+}
+
+// Number of cells that differ from grid, the index of the first in *first.
+uint16_t vt100_model_diff(const vt100_model_t *m, const vt100_cell_t *grid, uint16_t *first) {
+    uint16_t n, d = 0;
+    for (n = 0; n < (uint16_t)m->rows * m->cols; n++) {
+        if (vt100_model_eq(&m->cells[n], &grid[n])) continue;
+        if (d++ == 0 && first) *first = n;
+    }
+    return d;
+}
+
+// At the bottom margin the scroll region moves up, below it LF stops at
+// the last row.
+static void vt100_model_lf(vt100_model_t *m) {
+    uint16_t row = m->cols;
+    if (m->x != m->bottom) {
+        if (m->x < m->rows) m->x++;
+        return;
+    }
+    memmove(m->cells + (uint16_t)(m->top - 1) * row, m->cells + (uint16_t)m->top * row,
+            (uint16_t)(m->bottom - m->top) * row * sizeof(vt100_cell_t));
+    m->changed = true;
+    vt100_model_blank(m, (uint16_t)(m->bottom - 1) * row, (uint16_t)m->bottom * row);
+}
+
+// DEC Special Graphics, the glyphs vt100_dec_glyph picks plus the cross.
+static uint16_t vt100_model_graphics(uint8_t c) {
+    switch (c) {
+        case 'q': return 0x2500;
+        case 'x': return 0x2502;
+        case 'l': return 0x250C;
+        case 'k': return 0x2510;
+        case 'm': return 0x2514;
+        case 'j': return 0x2518;
+        case 't': return 0x251C;
+        case 'u': return 0x2524;
+        case 'w': return 0x252C;
+        case 'v': return 0x2534;
+        case 'n': return 0x253C;
+    }
+    return c;
+}
+
+static void vt100_model_put(vt100_model_t *m, uint16_t ch) {
+    vt100_cell_t *p;
+    if (m->wrap) {
+        m->wrap = false;
+        m->y = 1;
+        vt100_model_lf(m);
+    }
+    p = vt100_model_cell(m, m->x, m->y);
+    if (p->ch != ch || memcmp(&p->a, &m->attr, sizeof(p->a)) != 0) {
+        p->ch = ch;
+        p->a = m->attr;
+        m->changed = true;
+    }
+    m->last = ch;
+    m->printed = true;
+    if (m->y < m->cols) m->y++; else m->wrap = true;
+}
+
+static void vt100_model_sgr(vt100_model_t *m) {
+    uint8_t n, v;
+    for (n = 0; n < m->nparams; n++) {
+        v = m->params[n];
+        if (v == 0) {
+            m->attr.fg = DEFAULT; m->attr.bg = DEFAULT; m->attr.modes = 0;
+        } else if (v <= 8) {
+            m->attr.modes |= 1 << (v - 1);
+        } else if (v == 22) {
+            m->attr.modes &= ~3;
+        } else if (v >= 24 && v <= 28) {
+            m->attr.modes &= ~(1 << (v - 21));
+        } else if ((v >= 30 && v <= 37) || v == 39) {
+            m->attr.fg = v;
+        } else if ((v >= 40 && v <= 47) || v == 49) {
+            m->attr.bg = v - 10;
+        } else {
+            m->unknown++;
+        }
+    }
+}
+
+static void vt100_model_csi(vt100_model_t *m, uint8_t final) {
+    uint16_t a = m->params[0], b = m->params[1], here;
+    uint16_t n = a ? a : 1;
+    if (m->priv) {
+        if (a == 25 && (final == 'h' || final == 'l')) m->cursor_on = final == 'h';
+        else if (final != 'h' && final != 'l') m->unknown++;
+        return;     // other private modes (paste, sync) have no visible state
+    }
+    if (final != 'm' && final != 'b') m->wrap = false;
+    here = (uint16_t)(m->x - 1) * m->cols + (m->y - 1);
+    switch (final) {
+        case 'A': m->x = (m->x > n) ? m->x - n : 1; break;
+        case 'B': m->x = (m->x + n < m->rows) ? m->x + n : m->rows; break;
+        case 'C': m->y = (m->y + n < m->cols) ? m->y + n : m->cols; break;
+        case 'D': m->y = (m->y > n) ? m->y - n : 1; break;
+        case 'H':
+        case 'f':
+            m->x = a ? ((a < m->rows) ? a : m->rows) : 1;
+            m->y = b ? ((b < m->cols) ? b : m->cols) : 1;
+            break;
+        case 'J':
+            if (a == 0) vt100_model_blank(m, here, (uint16_t)m->rows * m->cols);
+            else if (a == 1) vt100_model_blank(m, 0, here + 1);
+            else if (a == 2) vt100_model_blank(m, 0, (uint16_t)m->rows * m->cols);
+            break;
+        case 'K':
+            here -= m->y - 1;
+            if (a == 0) vt100_model_blank(m, here + m->y - 1, here + m->cols);
+            else if (a == 1) vt100_model_blank(m, here, here + m->y);
+            else if (a == 2) vt100_model_blank(m, here, here + m->cols);
+            break;
+        case 'm': vt100_model_sgr(m); break;
+        case 'r':
+            b = b ? b : m->rows;
+            if ((a ? a : 1) < b && b <= m->rows) { m->top = a ? a : 1; m->bottom = b; }
+            m->x = 1; m->y = 1;
+            break;
+        case 'b': while (n--) vt100_model_put(m, m->last); break;
+        case 'n': break;    // the report goes to the host
+        default: m->unknown++;
+    }
+}
+
+static void vt100_model_c0(vt100_model_t *m, uint8_t c) {
+    switch (c) {
+        case '\r': m->y = 1; m->wrap = false; break;
+        case '\n': vt100_model_lf(m); m->wrap = false; break;
+        case '\b': if (m->y > 1) m->y--; m->wrap = false; break;
+        case '\t': m->y = ((m->y + 7) & ~7) + 1; if (m->y > m->cols) m->y = m->cols; break;
+        case '\a': break;
+        default: m->unknown++;
+    }
+}
+
+// What an action may change besides cells.
+typedef struct {
+    uint8_t x, y, charset;
+    bool wrap, cursor_on;
+    vt100_attr_t attr;
+} vt100_model_snap_t;
+
+static void vt100_model_snap(const vt100_model_t *m, vt100_model_snap_t *s) {
+    memset(s, 0, sizeof(*s));
+    s->x = m->x; s->y = m->y; s->charset = m->charset;
+    s->wrap = m->wrap; s->cursor_on = m->cursor_on;
+    s->attr = m->attr;
+}
+
+// An action (character, control or sequence) is complete. Printing is
+// wasted if no cell changed, anything else if the state did not change.
+static void vt100_model_done(vt100_model_t *m, const vt100_model_snap_t *before) {
+    vt100_model_snap_t after;
+    bool wasted = !m->changed;
+    if (wasted && !m->printed) {
+        vt100_model_snap(m, &after);
+        wasted = memcmp(before, &after, sizeof(after)) == 0;
+    }
+    if (wasted) m->wasted += m->seq_len;
+    m->seq_len = 0;
+    m->changed = false;
+    m->printed = false;
+}
+
+void vt100_model_feed(vt100_model_t *m, const uint8_t *data, uint32_t len) {
+    vt100_model_snap_t before;
+    uint8_t c;
+    for (; len--; data++) {
+        c = *data;
+        vt100_model_snap(m, &before);   // sequences only act on their last byte
+        m->seq_len++;
+        m->bytes++;
+        switch (m->state) {
+            case M_GROUND:
+                if (c == 0x1B) {
+                    m->need = 0;
+                    m->state = M_ESC;
+                    continue;
+                }
+                if (c < 0x20) {
+                    vt100_model_c0(m, c);
+                    break;
+                }
+                if (m->need && (c & 0xC0) == 0x80) {
+                    m->uch = (m->uch << 6) | (c & 0x3F);
+                    if (--m->need) continue;
+                    vt100_model_put(m, m->uch);
+                    break;
+                }
+                m->need = 0;
+                if (c >= 0xE0 && c < 0xF0) { m->uch = c & 0x0F; m->need = 2; continue; }
+                if (c >= 0xC0 && c < 0xE0) { m->uch = c & 0x1F; m->need = 1; continue; }
+                if (c >= 0x80) { m->unknown++; break; }
+                vt100_model_put(m, (m->charset == VT100_CS_GRAPHICS) ? vt100_model_graphics(c) : c);
+                break;
+            case M_ESC:
+                if (c == '[') {
+                    m->state = M_CSI;
+                    m->priv = 0;
+                    m->nparams = 0;
+                    memset(m->params, 0, sizeof(m->params));
+                    continue;
+                }
+                if (c == '(') { m->state = M_G0; continue; }
+                m->state = M_GROUND;
+                if (c == '7') {
+                    m->save_x = m->x; m->save_y = m->y;
+                    m->save_attr = m->attr; m->save_charset = m->charset;
+                    break;
+                }
+                if (c == '8') {
+                    m->x = m->save_x; m->y = m->save_y;
+                    m->attr = m->save_attr; m->charset = m->save_charset;
+                    m->wrap = false;
+                    break;
+                }
+                m->unknown++;
+                break;
+            case M_G0:
+                if (c == '0') m->charset = VT100_CS_GRAPHICS;
+                else if (c == 'B') m->charset = VT100_CS_ASCII;
+                else m->unknown++;
+                m->state = M_GROUND;
+                break;
+            case M_CSI:
+                if (c == '?' && m->nparams == 0 && m->params[0] == 0) { m->priv = c; continue; }
+                if (c >= '0' && c <= '9') {
+                    m->params[m->nparams] = m->params[m->nparams] * 10 + (c - '0');
+                    continue;
+                }
+                if (c == ';') {
+                    if (m->nparams < VT100_MODEL_PARAMS - 1) m->nparams++;
+                    continue;
+                }
+                m->nparams++;
+                m->state = M_GROUND;
+                if (c >= 0x40 && c <= 0x7E) vt100_model_csi(m, c);
+                else m->unknown++;
+                break;
+        }
+        vt100_model_done(m, &before);
+    }
+}
+
+void vt100_model_sink(void *ctx, const uint8_t *data, uint16_t len) {
+    vt100_model_feed(ctx, data, len);
+}
@@ -0,0 +1,76 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "vt100_print.h"
+
+// Headless model of the terminal on the other end. It understands what
+// vt100_print.c sends (C0 controls, CUP and relative moves, ED/EL, SGR,
+// REP, DECSTBM, DECSC/DECRC, G0 charset switches, UTF-8) and keeps the
+// resulting screen in a cell grid laid out like the shadow framebuffer.
+// Host side only.
+
+#define VT100_MODEL_PARAMS 8
+
+typedef struct {
+    vt100_cell_t *cells;
+    uint8_t rows;
+    uint8_t cols;
+    uint8_t x;              // cursor row, 1-based as in vt100_pos_x_y
+    uint8_t y;              // cursor column
+    bool wrap;              // last column written, the next character wraps
+    uint8_t top;            // scroll region set by DECSTBM
+    uint8_t bottom;
+    vt100_attr_t attr;      // SGR state, bg kept as 30..39 like vt100_attr_t
+    uint8_t charset;        // G0, VT100_CS_ASCII or VT100_CS_GRAPHICS
+    bool cursor_on;
+    uint16_t last;          // last printed character, for REP
+    uint8_t save_x;         // DECSC
+    uint8_t save_y;
+    vt100_attr_t save_attr;
+    uint8_t save_charset;
+    // Parser
+    uint8_t state;
+    uint8_t priv;           // '?' of a private CSI, 0 otherwise
+    uint8_t nparams;
+    uint16_t params[VT100_MODEL_PARAMS];
+    uint16_t uch;           // UTF-8 code point being assembled
+    uint8_t need;           // continuation bytes still missing
+    uint16_t seq_len;       // bytes of the action being parsed
+    bool changed;           // the action touched a cell
+    bool printed;           // the action printed a character
+    // Counters
+    uint32_t bytes;
+    uint32_t wasted;        // bytes of actions that changed nothing
+    uint32_t unknown;       // sequences the model ignores
+} vt100_model_t;
+
+void vt100_model_init(vt100_model_t *m, vt100_cell_t *cells, uint8_t rows, uint8_t cols);
+void vt100_model_resize(vt100_model_t *m, uint8_t rows, uint8_t cols);
+void vt100_model_feed(vt100_model_t *m, const uint8_t *data, uint32_t len);
+void vt100_model_sink(void *ctx, const uint8_t *data, uint16_t len);
+vt100_cell_t *vt100_model_cell(vt100_model_t *m, uint8_t x, uint8_t y);
+uint16_t vt100_model_diff(const vt100_model_t *m, const vt100_cell_t *grid, uint16_t *first);
@@ -0,0 +1,259 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "vt100_mux.h"
+
+static void vt100_mux_nonblock(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static bool vt100_mux_again(void) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+// A client hanging up must not raise SIGPIPE, ptys are not sockets.
+static ssize_t vt100_mux_write(int fd, const uint8_t *data, uint16_t len) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == ENOTSOCK) n = write(fd, data, len);
+    return n;
+}
+
+// Straight to the fd while nothing is queued, whatever it does not take
+// goes to pend. Once pend overflowed the stream has a hole, everything up
+// to the repaint is dropped.
+static void vt100_mux_sink(void *ctx, const uint8_t *data, uint16_t len) {
+    vt100_mux_client_t *c = ctx;
+    ssize_t n;
+    if (c->dead || c->lost) return;
+    if (c->pend_len == 0) {
+        n = vt100_mux_write(c->fd, data, len);
+        if (n < 0) {
+            if (!vt100_mux_again()) { c->dead = true; return; }
+            n = 0;
+        }
+        c->sent += n;
+        data += n;
+        len -= n;
+    }
+    if (len == 0) return;
+    if (c->pend_off + c->pend_len + len > VT100_MUX_PEND) {
+        memmove(c->pend, c->pend + c->pend_off, c->pend_len);
+        c->pend_off = 0;
+    }
+    if (c->pend_len + len > VT100_MUX_PEND) { c->lost = true; return; }
+    memcpy(c->pend + c->pend_off + c->pend_len, data, len);
+    c->pend_len += len;
+}
+
+static void vt100_mux_drain(vt100_mux_client_t *c) {
+    ssize_t n;
+    while (c->pend_len && !c->dead) {
+        n = vt100_mux_write(c->fd, c->pend + c->pend_off, c->pend_len);
+        if (n < 0) {
+            if (!vt100_mux_again()) c->dead = true;
+            return;
+        }
+        c->sent += n;
+        c->pend_off += n;
+        c->pend_len -= n;
+    }
+    c->pend_off = 0;
+}
+
+bool vt100_mux_init(vt100_mux_t *m, const vt100_instance_t *owner, uint8_t max_clients, uint8_t caps) {
+    uint8_t k;
+    m->owner = owner;
+    m->max = max_clients;
+    m->count = 0;
+    m->caps = caps;
+    m->listen_fd = -1;
+    m->client = calloc(max_clients, sizeof(vt100_mux_client_t));
+    if (m->client == NULL) return false;
+    for (k = 0; k < max_clients; k++) m->client[k].fd = -1;
+    return true;
+}
+
+void vt100_mux_close(vt100_mux_t *m) {
+    uint8_t k;
+    for (k = 0; k < m->max; k++) {
+        if (m->client[k].fd >= 0) vt100_mux_drop(m, &m->client[k]);
+    }
+    if (m->listen_fd >= 0) close(m->listen_fd);
+    m->listen_fd = -1;
+    free(m->client);
+    m->client = NULL;
+}
+
+int vt100_mux_listen_unix(vt100_mux_t *m, const char *path) {
+    struct sockaddr_un a;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    memset(&a, 0, sizeof(a));
+    a.sun_family = AF_UNIX;
+    strncpy(a.sun_path, path, sizeof(a.sun_path) - 1);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&a, sizeof(a)) < 0 || listen(fd, 16) < 0) { close(fd); return -1; }
+    vt100_mux_nonblock(fd);
+    return m->listen_fd = fd;
+}
+
+// Loopback only, the dashboard has no authentication.
+int vt100_mux_listen_tcp(vt100_mux_t *m, uint16_t port) {
+    struct sockaddr_in a;
+    int on = 1, fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&a, sizeof(a)) < 0 || listen(fd, 16) < 0) { close(fd); return -1; }
+    vt100_mux_nonblock(fd);
+    return m->listen_fd = fd;
+}
+
+// Any connected fd works, a socket or the master side of a pty. The
+// client starts with a cleared terminal and an unknown front, so its
+// first diff is a full repaint.
+vt100_mux_client_t *vt100_mux_add(vt100_mux_t *m, int fd) {
+    vt100_mux_client_t *c = NULL;
+    uint8_t k;
+    for (k = 0; k < m->max && c == NULL; k++) {
+        if (m->client[k].fd < 0) c = &m->client[k];
+    }
+    if (c == NULL) return NULL;
+    memset(c, 0, sizeof(*c));
+    c->front = malloc((uint16_t)m->owner->rows * m->owner->cols * sizeof(vt100_cell_t));
+    c->pend = malloc(VT100_MUX_PEND);
+    if (c->front == NULL || c->pend == NULL) {
+        free(c->front);
+        free(c->pend);
+        c->fd = -1;
+        return NULL;
+    }
+    c->fd = fd;
+    vt100_mux_nonblock(fd);
+    vt100_init(&c->vt);
+    c->vt.def = m->owner->def;
+    c->vt.caps = m->caps;
+    vt100_out_init(&c->vt.out, c->obuf, sizeof(c->obuf), vt100_mux_sink, c);
+    vt100_begin(&c->vt);
+    vt100_share(&c->vt, c->front, m->owner);
+    vt100_regions(&c->vt, m->owner->regions, m->owner->nregions);
+    c->vt.budget = VT100_MUX_BUDGET;
+    c->repaints = 1;
+    vt100_out_flush(&c->vt.out);
+    m->count++;
+    return c;
+}
+
+void vt100_mux_drop(vt100_mux_t *m, vt100_mux_client_t *c) {
+    close(c->fd);
+    free(c->front);
+    free(c->pend);
+    c->front = NULL;
+    c->pend = NULL;
+    c->fd = -1;
+    m->count--;
+}
+
+// The owner's grid changed size. Clients keep their own terminals, each
+// starts over with a cleared one and a full repaint, as on connect.
+void vt100_mux_resize(vt100_mux_t *m) {
+    vt100_mux_client_t *c;
+    vt100_cell_t *front;
+    uint8_t k;
+    for (k = 0; k < m->max; k++) {
+        c = &m->client[k];
+        if (c->fd < 0) continue;
+        front = realloc(c->front, (uint16_t)m->owner->rows * m->owner->cols * sizeof(vt100_cell_t));
+        if (front == NULL) { c->dead = true; continue; }
+        c->vt.front = NULL;
+        c->vt.back = NULL;  // the clear must not touch the owner's back
+        vt100_begin(&c->vt);
+        c->front = front;
+        vt100_share(&c->vt, c->front, m->owner);
+        c->repaints++;
+    }
+}
+
+// Accepts waiting connections and reads what clients sent, which a
+// dashboard ignores; end of file or an error drops the client. Returns
+// the number of new clients, they want a frame.
+uint8_t vt100_mux_poll(vt100_mux_t *m) {
+    uint8_t buf[64], k, added = 0;
+    ssize_t n;
+    int fd;
+    while (m->listen_fd >= 0 && (fd = accept(m->listen_fd, NULL, NULL)) >= 0) {
+        if (vt100_mux_add(m, fd) == NULL) close(fd);
+        else added++;
+    }
+    for (k = 0; k < m->max; k++) {
+        if (m->client[k].fd < 0) continue;
+        while ((n = read(m->client[k].fd, buf, sizeof(buf))) > 0) continue;
+        if (n == 0 || !vt100_mux_again()) vt100_mux_drop(m, &m->client[k]);
+    }
+    return added;
+}
+
+// One diff per client that has nothing queued, against its own front.
+void vt100_mux_flush(vt100_mux_t *m) {
+    vt100_mux_client_t *c;
+    uint8_t k;
+    for (k = 0; k < m->max; k++) {
+        c = &m->client[k];
+        if (c->fd < 0) continue;
+        vt100_mux_drain(c);
+        if (!c->dead && c->pend_len == 0) {
+            if (c->lost) {
+                c->lost = false;
+                c->repaints++;
+                vt100_invalidate(&c->vt);
+            }
+            vt100_flush(&c->vt);
+            c->frames++;
+        } else {
+            c->skipped++;
+        }
+        if (c->dead) vt100_mux_drop(m, c);
+    }
+}
+
+// Some client has queued output or a diff left over, flush again soon.
+bool vt100_mux_busy(const vt100_mux_t *m) {
+    uint8_t k;
+    for (k = 0; k < m->max; k++) {
+        if (m->client[k].fd >= 0 && (m->client[k].pend_len || m->client[k].vt.behind)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,76 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "vt100_print.h"
+
+// POSIX only: one screen, many terminals. The application draws into the
+// owner instance as usual; every client is a vt100_share view of the
+// owner's back grid with its own front, terminal state and output queue.
+// A client gets a diff only once the kernel took everything queued for
+// it before, so its front is what it acknowledged. A slow client just
+// skips frames and later gets one diff over all it missed, without ever
+// holding up the others.
+
+#define VT100_MUX_OBUF   512    // vt100_out buffer per client
+#define VT100_MUX_PEND   8192   // bytes a client may have queued
+#define VT100_MUX_BUDGET 4096   // per diff, keeps one diff inside PEND
+
+typedef struct {
+    int fd;                 // -1 if the slot is free
+    vt100_instance_t vt;
+    vt100_cell_t *front;
+    uint8_t *pend;          // output the fd did not take yet
+    uint16_t pend_off;
+    uint16_t pend_len;
+    bool lost;              // pend overflowed, needs a full repaint
+    bool dead;              // write failed, dropped by the next flush
+    uint32_t sent;          // bytes the fd took
+    uint32_t frames;        // diffs made
+    uint32_t skipped;       // frames skipped while output was queued
+    uint32_t repaints;      // full repaints after connect or overflow
+    uint8_t obuf[VT100_MUX_OBUF];
+} vt100_mux_client_t;
+
+typedef struct {
+    const vt100_instance_t *owner;
+    vt100_mux_client_t *client;
+    uint8_t max;
+    uint8_t count;
+    uint8_t caps;           // given to new clients
+    int listen_fd;
+} vt100_mux_t;
+
+bool vt100_mux_init(vt100_mux_t *m, const vt100_instance_t *owner, uint8_t max_clients, uint8_t caps);
+void vt100_mux_close(vt100_mux_t *m);
+int vt100_mux_listen_unix(vt100_mux_t *m, const char *path);
+int vt100_mux_listen_tcp(vt100_mux_t *m, uint16_t port);
+vt100_mux_client_t *vt100_mux_add(vt100_mux_t *m, int fd);
+void vt100_mux_drop(vt100_mux_t *m, vt100_mux_client_t *c);
+void vt100_mux_resize(vt100_mux_t *m);
+uint8_t vt100_mux_poll(vt100_mux_t *m);
+void vt100_mux_flush(vt100_mux_t *m);
+bool vt100_mux_busy(const vt100_mux_t *m);
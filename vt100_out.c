@@ -0,0 +1,202 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "vt100_out.h"
+#include <string.h>
+#ifndef __AVR__
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+void vt100_out_init(vt100_out_t *o, uint8_t *buf, uint16_t size, vt100_sink_t sink, void *ctx) {
+    o->buf = buf;
+    o->size = buf ? size : 0;
+    o->len = 0;
+    o->sink = sink;
+    o->ctx = ctx;
+    o->bytes = 0;
+    o->escapes = 0;
+    o->writes = 0;
+    o->flushes = 0;
+    o->hold = false;
+}
+
+static void vt100_out_send(vt100_out_t *o) {
+    o->flushes++;
+    if (o->len == 0) return;
+    o->writes++;
+    o->sink(o->ctx, o->buf, o->len);
+    o->len = 0;
+}
+
+// While hold is set only a full buffer goes out, see vt100_frame_begin.
+void vt100_out_flush(vt100_out_t *o) {
+    if (!o->hold) vt100_out_send(o);
+}
+
+void vt100_out_byte(vt100_out_t *o, uint8_t c) {
+    o->bytes++;
+    if (c == 0x1B) o->escapes++;
+    if (o->size == 0) { o->writes++; o->sink(o->ctx, &c, 1); return; }
+    if (o->len == o->size) vt100_out_send(o);
+    o->buf[o->len++] = c;
+}
+
+void vt100_out_data(vt100_out_t *o, const uint8_t *data, uint16_t len) {
+    while (len--) vt100_out_byte(o, *data++);
+}
+
+// A PROGMEM block such as a precompiled screen. Flash is not addressable
+// like RAM on AVR, so there it goes through the buffer byte by byte;
+// anywhere else the sink gets the whole block in one call, unless it fits
+// the buffer of a held frame.
+void vt100_out_data_P(vt100_out_t *o, const uint8_t *data, uint16_t len) {
+#ifdef __AVR__
+    while (len--) vt100_out_byte(o, pgm_read_byte(data++));
+#else
+    uint16_t n;
+    if (o->hold && len <= o->size - o->len) {
+        vt100_out_data(o, data, len);
+        return;
+    }
+    vt100_out_send(o);
+    o->bytes += len;
+    for (n = 0; n < len; n++) if (data[n] == 0x1B) o->escapes++;
+    o->writes++;
+    o->sink(o->ctx, data, len);
+#endif
+}
+
+void vt100_out_str(vt100_out_t *o, const char *s) {
+    while (*s) vt100_out_byte(o, *s++);
+}
+
+void vt100_out_str_P(vt100_out_t *o, const char *s) {
+    uint8_t c;
+    while ((c = pgm_read_byte(s++)) != 0) vt100_out_byte(o, c);
+}
+
+// Falls back to 16-bit division as soon as the value fits, 32-bit
+// division is a library call on 8-bit cores.
+uint8_t vt100_utoa(char *buf, uint32_t v) {
+    char tmp[10];
+    uint8_t n = 0, len = 0;
+    uint16_t w;
+    while (v > 0xFFFF) {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    }
+    w = v;
+    do {
+        tmp[n++] = '0' + w % 10;
+        w /= 10;
+    } while (w);
+    while (n) buf[len++] = tmp[--n];
+    buf[len] = 0;
+    return len;
+}
+
+// Fixed point with scale digits after the point, at most 9, 3854 at
+// scale 3 -> "3.854". The point goes into the digits of vt100_utoa, so
+// this needs no division of its own.
+uint8_t vt100_fixtoa(char *buf, uint32_t v, uint8_t scale) {
+    uint8_t len = vt100_utoa(buf, v), pad;
+    if (scale == 0) return len;
+    pad = (len > scale) ? 0 : scale + 1 - len;
+    memmove(buf + pad, buf, len + 1);
+    memset(buf, '0', pad);
+    len += pad;
+    memmove(buf + len - scale + 1, buf + len - scale, scale + 1);
+    buf[len - scale] = '.';
+    return len + 1;
+}
+
+// Millivolts as volts with three decimals, 3854 -> "3.854"
+uint8_t vt100_mvtoa(char *buf, uint16_t mv) {
+    return vt100_fixtoa(buf, mv, 3);
+}
+
+void vt100_out_u8(vt100_out_t *o, uint8_t v) {
+    if (v >= 100) { vt100_out_byte(o, '0' + v / 100); v %= 100; vt100_out_byte(o, '0' + v / 10); }
+    else if (v >= 10) vt100_out_byte(o, '0' + v / 10);
+    vt100_out_byte(o, '0' + v % 10);
+}
+
+void vt100_out_u16(vt100_out_t *o, uint16_t v) {
+    char buf[VT100_NUM_MAX];
+    vt100_utoa(buf, v);
+    vt100_out_str(o, buf);
+}
+
+void vt100_out_u32(vt100_out_t *o, uint32_t v) {
+    char buf[VT100_NUM_MAX];
+    vt100_utoa(buf, v);
+    vt100_out_str(o, buf);
+}
+
+void vt100_out_mv(vt100_out_t *o, uint16_t mv) {
+    char buf[VT100_NUM_MAX];
+    vt100_mvtoa(buf, mv);
+    vt100_out_str(o, buf);
+}
+
+// ESC[nX, n == 0 leaves the parameter out
+void vt100_out_csi(vt100_out_t *o, uint8_t n, char final) {
+    vt100_out_byte(o, 0x1B);
+    vt100_out_byte(o, '[');
+    if (n) vt100_out_u8(o, n);
+    vt100_out_byte(o, final);
+}
+
+void vt100_out_csi2(vt100_out_t *o, uint8_t a, uint8_t b, char final) {
+    vt100_out_byte(o, 0x1B);
+    vt100_out_byte(o, '[');
+    vt100_out_u8(o, a);
+    vt100_out_byte(o, ';');
+    vt100_out_u8(o, b);
+    vt100_out_byte(o, final);
+}
+
+void vt100_sink_null(void *ctx, const uint8_t *data, uint16_t len) {
+}
+
+#ifndef __AVR__
+// Waits out a signal or a non-blocking stdout that is full, only a real
+// write error drops the rest.
+void vt100_sink_stdout(void *ctx, const uint8_t *data, uint16_t len) {
+    struct pollfd p = { STDOUT_FILENO, POLLOUT, 0 };
+    ssize_t n;
+    while (len) {
+        if ((n = write(STDOUT_FILENO, data, len)) > 0) {
+            data += n;
+            len -= n;
+        } else if (n == -1 && errno == EAGAIN) {
+            poll(&p, 1, -1);
+        } else if (n != -1 || errno != EINTR) {
+            return;
+        }
+    }
+}
+#endif
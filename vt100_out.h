@@ -0,0 +1,76 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#define F(x)    (x)
+#define PSTR(x) (x)
+#define PROGMEM
+#define printf_P printf
+#define fprintf_P fprintf
+#define fputs_P fputs
+#define snprintf_P snprintf
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+
+// Receives everything the output layer produces, in buffer sized chunks.
+typedef void (*vt100_sink_t)(void *ctx, const uint8_t *data, uint16_t len);
+
+typedef struct {
+    uint8_t      *buf;  // caller supplied, may be NULL for byte-wise output
+    uint16_t     size;
+    uint16_t     len;
+    vt100_sink_t sink;
+    void         *ctx;
+    uint32_t     bytes; // everything ever written, flushed or not
+    uint32_t     escapes;   // ESC bytes among them
+    uint32_t     writes;    // sink calls
+    uint32_t     flushes;   // vt100_out_flush calls, a full buffer included
+    bool         hold;      // keep output until the buffer fills or hold ends
+} vt100_out_t;
+
+// Longest text vt100_utoa/vt100_fixtoa can produce, with the terminator
+#define VT100_NUM_MAX 12
+
+void vt100_out_init(vt100_out_t *o, uint8_t *buf, uint16_t size, vt100_sink_t sink, void *ctx);
+void vt100_out_flush(vt100_out_t *o);
+void vt100_out_byte(vt100_out_t *o, uint8_t c);
+void vt100_out_data(vt100_out_t *o, const uint8_t *data, uint16_t len);
+void vt100_out_data_P(vt100_out_t *o, const uint8_t *data, uint16_t len);
+void vt100_out_str(vt100_out_t *o, const char *s);
+void vt100_out_str_P(vt100_out_t *o, const char *s);
+void vt100_out_u8(vt100_out_t *o, uint8_t v);
+void vt100_out_u16(vt100_out_t *o, uint16_t v);
+void vt100_out_u32(vt100_out_t *o, uint32_t v);
+void vt100_out_mv(vt100_out_t *o, uint16_t mv);
+void vt100_out_csi(vt100_out_t *o, uint8_t n, char final);
+void vt100_out_csi2(vt100_out_t *o, uint8_t a, uint8_t b, char final);
+
+uint8_t vt100_utoa(char *buf, uint32_t v);
+uint8_t vt100_fixtoa(char *buf, uint32_t v, uint8_t scale);
+uint8_t vt100_mvtoa(char *buf, uint16_t mv);
+
+void vt100_sink_null(void *ctx, const uint8_t *data, uint16_t len);
+void vt100_sink_stdout(void *ctx, const uint8_t *data, uint16_t len);
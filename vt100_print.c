@@ -23,55 +23,439 @@
  */
 
 #include "vt100_print.h"
-#include <stdio.h>
 #include <string.h>
 
-const char pStr_send_format[] PROGMEM = { "\x1B[%um" };
+#define CH_HORIZONTAL   0x2500  // ─
+#define CH_VERTICAL     0x2502  // │
+#define CH_TOP_LEFT     0x250C  // ┌
+#define CH_TOP_RIGHT    0x2510  // ┐
+#define CH_BOTTOM_LEFT  0x2514  // └
+#define CH_BOTTOM_RIGHT 0x2518  // ┘
+#define CH_TEE_RIGHT    0x251C  // ├
+#define CH_TEE_LEFT     0x2524  // ┤
+#define CH_TEE_DOWN     0x252C  // ┬
+#define CH_TEE_UP       0x2534  // ┴
+#define CH_BLOCK_LOW    0x2581  // ▁, lower n/8 is CH_BLOCK_LOW - 1 + n
+#define CH_BLOCK_FULL   0x2588  // █
+#define CH_BLOCK_LEFT_0 0x2590  // left n/8 is CH_BLOCK_LEFT_0 - n, ▏ to ▉
 
-void vt100_Printer_Text_Color(FILE *f, vt100_color_t _Color) {
-    if (_Color > BLACK) { fprintf_P(f, pStr_send_format, _Color); }
+const char pStr_send_clear[] PROGMEM = { "\x1B[" };
+
+// Line drawing glyph in the DEC Special Graphics set, 0 if there is none.
+static uint8_t vt100_dec_glyph(vt100_instance_t *i, uint16_t ch) {
+    if (!(i->caps & VT100_CAP_DEC_LINES)) return 0;
+    switch (ch) {
+        case CH_HORIZONTAL:   return 'q';
+        case CH_VERTICAL:     return 'x';
+        case CH_TOP_LEFT:     return 'l';
+        case CH_TOP_RIGHT:    return 'k';
+        case CH_BOTTOM_LEFT:  return 'm';
+        case CH_BOTTOM_RIGHT: return 'j';
+        case CH_TEE_RIGHT:    return 't';
+        case CH_TEE_LEFT:     return 'u';
+        case CH_TEE_DOWN:     return 'w';
+        case CH_TEE_UP:       return 'v';
+        default:              return 0;
+    }
 }
 
-void vt100_Printer_Text_Format(FILE *f, vt100_format_t _Format) {
-    if (_Format > F_NOT_SET) { fprintf_P(f, pStr_send_format, (uint8_t)_Format - 1); }
+static uint8_t vt100_ch_charset(vt100_instance_t *i, uint16_t ch) {
+    return vt100_dec_glyph(i, ch) ? VT100_CS_GRAPHICS : VT100_CS_ASCII;
 }
 
-void vt100_Printer_Background_Color(FILE *f, vt100_color_t _Color) {
-    if (_Color >= BLACK) { fprintf_P(f, pStr_send_format, (uint8_t)_Color + 10); }
+static uint8_t vt100_ch_len(vt100_instance_t *i, uint16_t ch) {
+    if (vt100_dec_glyph(i, ch)) return 1;
+    return (ch < 0x80) ? 1 : (ch < 0x800) ? 2 : 3;
 }
 
-const char pStr_send_clear[] PROGMEM = { "\x1B[" };
+static void vt100_charset(vt100_instance_t *i, uint8_t cs) {
+    if (i->charset == cs) return;
+    vt100_out_str_P(&i->out, (cs == VT100_CS_GRAPHICS) ? PSTR("\x1B(0") : PSTR("\x1B(B"));
+    i->charset = cs;
+}
+
+static uint8_t vt100_digits(uint8_t n) {
+    return (n >= 100) ? 3 : (n >= 10) ? 2 : 1;
+}
+
+// ESC[nX with the count left out when it is 1
+static uint8_t vt100_csi_cost(uint8_t n) {
+    return (n == 1) ? 3 : 3 + vt100_digits(n);
+}
+
+// Moves the tracked cursor after n printed cells, a cursor parked on the
+// last column is waiting to wrap and no longer trusted.
+static void vt100_advance(vt100_instance_t *i, uint8_t n) {
+    uint8_t width = i->cols ? i->cols : VT100_COLS_DEFAULT;
+    i->cy += n;
+    if (i->cy > width) i->cur_known = false;
+}
+
+static void vt100_put_ch(vt100_instance_t *i, uint16_t ch) {
+    vt100_out_t *o = &i->out;
+    uint8_t dec = vt100_dec_glyph(i, ch);
+    vt100_charset(i, dec ? VT100_CS_GRAPHICS : VT100_CS_ASCII);
+    if (dec) {
+        vt100_out_byte(o, dec);
+    } else if (ch < 0x80) {
+        vt100_out_byte(o, ch);
+    } else if (ch < 0x800) {
+        vt100_out_byte(o, 0xC0 | (ch >> 6));
+        vt100_out_byte(o, 0x80 | (ch & 0x3F));
+    } else {
+        vt100_out_byte(o, 0xE0 | (ch >> 12));
+        vt100_out_byte(o, 0x80 | ((ch >> 6) & 0x3F));
+        vt100_out_byte(o, 0x80 | (ch & 0x3F));
+    }
+    vt100_advance(i, 1);
+}
+
+// n copies of ch, the tail as one REP (ESC[nb) when the terminal has it
+// and that is shorter.
+static void vt100_put_run(vt100_instance_t *i, uint16_t ch, uint8_t n) {
+    uint16_t bytes;
+    if (n == 0) return;
+    vt100_put_ch(i, ch);
+    bytes = (uint16_t)(n - 1) * vt100_ch_len(i, ch);
+    if ((i->caps & VT100_CAP_REP) && n > 2 && bytes > vt100_csi_cost(n - 1)) {
+        vt100_out_csi(&i->out, n - 1, 'b');
+        vt100_advance(i, n - 1);
+        return;
+    }
+    while (--n) vt100_put_ch(i, ch);
+}
+
+static uint8_t vt100_str_cells(const char *txt) {
+    uint8_t n = 0;
+    while (*txt) {
+        if ((*txt++ & 0xC0) != 0x80) n++;
+    }
+    return n;
+}
+
+static uint8_t vt100_str_cells_P(const char *txt) {
+    uint8_t n = 0;
+    char c;
+    while ((c = pgm_read_byte(txt++)) != 0) {
+        if ((c & 0xC0) != 0x80) n++;
+    }
+    return n;
+}
+
+static uint8_t vt100_rd(const uint8_t *s, bool pgm) {
+    return pgm ? pgm_read_byte(s) : *s;
+}
+
+// Decodes one UTF-8 sequence, code points outside the BMP become '?'.
+// pgm reads the text from flash.
+static uint16_t vt100_get_ch(const char **txt, bool pgm) {
+    const uint8_t *s = (const uint8_t *)*txt;
+    uint16_t ch = vt100_rd(s++, pgm);
+    uint8_t more = 0, b;
+    if      (ch >= 0xF0) { ch = '?'; more = 3; }
+    else if (ch >= 0xE0) { ch &= 0x0F; more = 2; }
+    else if (ch >= 0xC0) { ch &= 0x1F; more = 1; }
+    else if (ch >= 0x80) { ch = '?'; }
+    while (more-- && ((b = vt100_rd(s, pgm)) & 0xC0) == 0x80) {
+        if (ch != '?') ch = (ch << 6) | (b & 0x3F);
+        s++;
+    }
+    *txt = (const char *)s;
+    return ch;
+}
+
+static uint8_t vt100_mode_bit(vt100_format_t _Format) {
+    return (_Format > MODESOFF) ? 1 << ((uint8_t)_Format - 2) : 0;
+}
+
+// Overlays a vt100_ccf_t the same way the terminal applies it.
+static void vt100_attr_set(vt100_attr_t *a, const vt100_ccf_t *c) {
+    if (c->Default_Color != C_NOT_SET) a->fg = c->Default_Color;
+    if (c->Background_Color != C_NOT_SET) a->bg = c->Background_Color;
+    if (c->Format == MODESOFF) {
+        a->fg = DEFAULT; a->bg = DEFAULT; a->modes = 0;
+    } else {
+        a->modes |= vt100_mode_bit(c->Format);
+    }
+}
+
+static void vt100_attr_def(vt100_instance_t *i, vt100_attr_t *a) {
+    a->fg = DEFAULT;
+    a->bg = DEFAULT;
+    a->modes = 0;
+    vt100_attr_set(a, &i->def);
+}
+
+static void vt100_set_clear(vt100_instance_t *i) {
+    i->set.Default_Color = C_NOT_SET;
+    i->set.Background_Color = C_NOT_SET;
+    i->set.Format = F_NOT_SET;
+}
+
+// One parameter of an SGR sequence, sent unless dry. Returns its bytes.
+static uint8_t vt100_sgr_param(vt100_instance_t *i, uint8_t *n, uint8_t v, bool send) {
+    bool first = (*n)++ == 0;
+    if (send) {
+        first ? vt100_out_str_P(&i->out, pStr_send_clear) : vt100_out_byte(&i->out, ';');
+        vt100_out_u8(&i->out, v);
+    }
+    return (first ? 2 : 1) + vt100_digits(v);
+}
+
+// Brings the terminal from i->sgr to w with at most one sequence, with
+// send false only its length is returned. Dropping a mode needs a full
+// reset, anything else is sent as a delta.
+static uint8_t vt100_sgr_delta(vt100_instance_t *i, const vt100_attr_t *w, bool send) {
+    vt100_attr_t t = i->sgr;
+    uint8_t n = 0, m, add, cost = 0;
+    if (i->sgr_known && t.fg == w->fg && t.bg == w->bg && t.modes == w->modes) return 0;
+    if (!i->sgr_known || (t.modes & ~w->modes)) {
+        cost += vt100_sgr_param(i, &n, 0, send);
+        t.fg = DEFAULT; t.bg = DEFAULT; t.modes = 0;
+    }
+    add = w->modes & ~t.modes;
+    for (m = 0; m < 8; m++) {
+        if (add & (1 << m)) cost += vt100_sgr_param(i, &n, m + 1, send);
+    }
+    if (w->bg != t.bg) cost += vt100_sgr_param(i, &n, w->bg + 10, send);
+    if (w->fg != t.fg) cost += vt100_sgr_param(i, &n, w->fg, send);
+    if (n) cost++;
+    if (send) {
+        if (n) vt100_out_byte(&i->out, 'm');
+        i->sgr = *w;
+        i->sgr_known = true;
+    }
+    return cost;
+}
+
+static void vt100_sgr_sync(vt100_instance_t *i) {
+    vt100_sgr_delta(i, &i->want, true);
+}
+
+static bool vt100_cell_eq(const vt100_cell_t *a, const vt100_cell_t *b) {
+    return a->ch == b->ch && a->a.fg == b->a.fg && a->a.bg == b->a.bg && a->a.modes == b->a.modes;
+}
+
+static vt100_cell_t *vt100_cell(vt100_instance_t *i, vt100_cell_t *grid, uint8_t x, uint8_t y) {
+    if (x < 1 || y < 1 || x > i->rows || y > i->cols) return NULL;
+    return &grid[(uint16_t)(x - 1) * i->cols + (y - 1)];
+}
+
+static bool vt100_win_has(const vt100_win_t *w, uint8_t x, uint8_t y) {
+    return x >= w->x1 && x <= w->x2 && y >= w->y1 && y <= w->y2;
+}
+
+// A cell drawn by layer 'from' goes to the save copy of the lowest window
+// above that layer covering it, to back if there is none.
+static void vt100_layer_put(vt100_instance_t *i, vt100_win_t *from, uint8_t x, uint8_t y, const vt100_cell_t *c) {
+    vt100_win_t *w, *cover = NULL;
+    vt100_cell_t *p;
+    for (w = i->top; w != from; w = w->below)
+        if (vt100_win_has(w, x, y)) cover = w;
+    if (cover) p = &cover->save[(uint16_t)(x - cover->x1) * (cover->y2 - cover->y1 + 1) + (y - cover->y1)];
+    else p = vt100_cell(i, i->back, x, y);
+    if (p) *p = *c;
+}
+
+// Shadow drawing ends here, clipped to the window drawn into.
+static void vt100_put_cell(vt100_instance_t *i, uint8_t x, uint8_t y, const vt100_cell_t *c) {
+    if (i->layer && !vt100_win_has(i->layer, x, y)) return;
+    if (i->top == NULL) {
+        vt100_cell_t *p = vt100_cell(i, i->back, x, y);
+        if (p) *p = *c;
+        return;
+    }
+    vt100_layer_put(i, i->layer, x, y, c);
+}
+
+static void vt100_fill(vt100_instance_t *i, vt100_cell_t *grid, uint16_t ch) {
+    vt100_cell_t c;
+    uint16_t n = (uint16_t)i->rows * i->cols;
+    c.ch = ch;
+    vt100_attr_def(i, &c.a);
+    while (n--) grid[n] = c;
+}
 
 void vt100_clear(vt100_instance_t *i, vt100_clear_t t) {
-    fprintf_P(i->f, pStr_send_clear);
+    vt100_sgr_sync(i);  // erased cells take the current background
+    vt100_out_str_P(&i->out, pStr_send_clear);
     switch (t) {
-        case LINE_AFTER_CURSOR: fprintf_P(i->f, PSTR("K"));  break;
-        case LINE_TO_CURSOR:    fprintf_P(i->f, PSTR("1K")); break;
-        case LINE:              fprintf_P(i->f, PSTR("2K")); break;
-        case SCREEN:            fprintf_P(i->f, PSTR("2J")); break;
+        case LINE_AFTER_CURSOR: vt100_out_str_P(&i->out, PSTR("K"));  break;
+        case LINE_TO_CURSOR:    vt100_out_str_P(&i->out, PSTR("1K")); break;
+        case LINE:              vt100_out_str_P(&i->out, PSTR("2K")); break;
+        case SCREEN:            vt100_out_str_P(&i->out, PSTR("2J")); break;
         default: {
-            fprintf_P(i->f, PSTR("1;1H"));
-            fprintf_P(i->f, pStr_send_clear);
-            fprintf_P(i->f, PSTR("2J"));
+            vt100_out_str_P(&i->out, PSTR("1;1H"));
+            vt100_out_str_P(&i->out, pStr_send_clear);
+            vt100_out_str_P(&i->out, PSTR("2J"));
         }
     }
+    if (t == ALL) { i->cx = 1; i->cy = 1; i->cur_known = true; }
+    if (i->back == NULL) return;
+    if (t >= SCREEN) {
+        if (i->front) vt100_fill(i, i->front, ' ');
+        vt100_fill(i, i->back, ' ');
+    } else {
+        // The shadow does not know which line the cursor is on
+        vt100_invalidate(i);
+    }
 }
 
+// Unbuffered output to stdout until vt100_out_init gives the instance a
+// buffer and a sink. AVR has no stdout, there output goes nowhere.
 void vt100_init(vt100_instance_t *i) {
-    i->f = stdout;
+#ifdef __AVR__
+    vt100_out_init(&i->out, NULL, 0, vt100_sink_null, NULL);
+#else
+    vt100_out_init(&i->out, NULL, 0, vt100_sink_stdout, NULL);
+#endif
     i->def.Default_Color = WHITE;
     i->def.Background_Color = BLUE;
     i->def.Format = BOLD;
-    i->set.Default_Color = C_NOT_SET;
-    i->set.Background_Color = C_NOT_SET;
-    i->set.Format = F_NOT_SET;
+    vt100_set_clear(i);
+    vt100_attr_def(i, &i->want);
+    i->sgr_known = false;
+    i->cur_known = false;
+    i->caps = 0;
+    i->charset = VT100_CS_ASCII;
+    i->move_bytes = 0;
+    i->move_cup_bytes = 0;
+    i->front = NULL;
+    i->back = NULL;
+    i->rows = 0;
+    i->cols = 0;
+    i->regions = NULL;
+    i->nregions = 0;
+    i->budget = 0;
+    i->link = 0;
+    i->behind = false;
+    memset(&i->stats, 0, sizeof(i->stats));
+    i->top = NULL;
+    i->layer = NULL;
+}
+
+// Without a front the instance only draws into back, for others to show
+// through vt100_share.
+void vt100_shadow(vt100_instance_t *i, vt100_cell_t *front, vt100_cell_t *back, uint8_t rows, uint8_t cols) {
+    i->front = front;
+    i->back = back;
+    i->rows = rows;
+    i->cols = cols;
+    i->top = NULL;
+    i->layer = NULL;
+    if (back == NULL) return;
+    vt100_fill(i, back, ' ');
+    vt100_invalidate(i);
+}
+
+// One more terminal showing owner's back grid. It gets its own front and
+// terminal state, back is left as it is. Nothing may draw through i.
+void vt100_share(vt100_instance_t *i, vt100_cell_t *front, const vt100_instance_t *owner) {
+    i->front = front;
+    i->back = owner->back;
+    i->rows = owner->rows;
+    i->cols = owner->cols;
+    vt100_invalidate(i);
+}
+
+// Moves the rows of grid from old_cols to i->cols cells apiece in place,
+// cells that are new get ch. Only for a grid that grew.
+static void vt100_restride(vt100_instance_t *i, vt100_cell_t *grid, uint8_t old_rows, uint8_t old_cols, uint16_t ch) {
+    vt100_cell_t c;
+    uint16_t n = (uint16_t)i->rows * i->cols;
+    uint8_t x = old_rows, y;
+    c.ch = ch;
+    vt100_attr_def(i, &c.a);
+    while (n > (uint16_t)old_rows * i->cols) grid[--n] = c;
+    while (x--) {
+        memmove(&grid[(uint16_t)x * i->cols], &grid[(uint16_t)x * old_cols], old_cols * sizeof(vt100_cell_t));
+        for (y = old_cols; y < i->cols; y++) grid[(uint16_t)x * i->cols + y] = c;
+    }
+}
+
+// The terminal is rows x cols now, front and back must hold that many
+// cells. Back comes out blank for the application to draw the new layout
+// into, open windows are gone. A terminal that grew keeps what it showed,
+// so front does too and the next flush sends only what the layout moved.
+// The new cells are erased in the default style, an EL right of every old
+// row and an ED below them. One that shrank may have wrapped or scrolled
+// its lines, it is cleared.
+void vt100_resize(vt100_instance_t *i, uint8_t rows, uint8_t cols) {
+    uint8_t old_rows = i->rows, old_cols = i->cols, x;
+    i->rows = rows;
+    i->cols = cols;
+    i->top = NULL;
+    i->layer = NULL;
+    i->cur_known = false;
+    if (i->back == NULL || rows < old_rows || cols < old_cols) {
+        vt100_clear(i, ALL);
+        return;
+    }
+    vt100_attr_def(i, &i->want);
+    vt100_sgr_sync(i);  // erased cells take the current background
+    for (x = 1; cols > old_cols && x <= old_rows; x++) {
+        vt100_pos_x_y(i, x, old_cols + 1);
+        vt100_out_str_P(&i->out, PSTR("\x1B[K"));
+    }
+    if (rows > old_rows) {
+        vt100_pos_x_y(i, old_rows + 1, 1);
+        vt100_out_str_P(&i->out, PSTR("\x1B[J"));
+    }
+    if (i->front) vt100_restride(i, i->front, old_rows, old_cols, ' ');
+    vt100_fill(i, i->back, ' ');
+}
+
+// Where no tty driver knows the size, e.g. over a bare UART: the cursor
+// goes as far as the terminal lets it and the terminal reports where that
+// is, the parser hands it on as KBD_BTN_CPR. DECSC and DECRC put the
+// cursor back, so what the instance tracks stays true.
+void vt100_query_size(vt100_instance_t *i) {
+    vt100_out_str_P(&i->out, PSTR("\x1B" "7" "\x1B[999;999H\x1B[6n\x1B" "8"));
+}
+
+void vt100_invalidate(vt100_instance_t *i) {
+    i->sgr_known = false;
+    i->cur_known = false;
+    if (i->caps & VT100_CAP_DEC_LINES) i->charset = VT100_CS_UNKNOWN;
+    if (i->front) vt100_fill(i, i->front, VT100_CH_UNKNOWN);
+}
+
+// The terminal shows back already, e.g. after a precompiled screen went
+// out: take it as front without sending anything. Cursor, SGR and charset
+// are whatever that stream left behind.
+void vt100_commit(vt100_instance_t *i) {
+    i->sgr_known = false;
+    i->cur_known = false;
+    if (i->caps & VT100_CAP_DEC_LINES) i->charset = VT100_CS_UNKNOWN;
+    if (i->front) memcpy(i->front, i->back, (uint16_t)i->rows * i->cols * sizeof(vt100_cell_t));
 }
 
 void vt100_cursor(vt100_instance_t *i, bool cursor) {
-    (cursor == true) ? fprintf_P(i->f, PSTR("\x1B[?25h")) : fprintf_P(i->f, PSTR("\x1B[?25l"));
+    (cursor == true) ? vt100_out_str_P(&i->out, PSTR("\x1B[?25h")) : vt100_out_str_P(&i->out, PSTR("\x1B[?25l"));
+}
+
+// Bracketed paste, the terminal wraps pasted text in ESC[200~ ... ESC[201~
+void vt100_paste_mode(vt100_instance_t *i, bool paste) {
+    (paste == true) ? vt100_out_str_P(&i->out, PSTR("\x1B[?2004h")) : vt100_out_str_P(&i->out, PSTR("\x1B[?2004l"));
+}
+
+// Everything up to vt100_frame_end leaves in one write when it fits the
+// out buffer, size that for a whole frame. With VT100_CAP_SYNC the terminal
+// also holds the display until the frame is complete (DEC mode 2026).
+void vt100_frame_begin(vt100_instance_t *i) {
+    i->out.hold = true;
+    if (i->caps & VT100_CAP_SYNC) vt100_out_str_P(&i->out, PSTR("\x1B[?2026h"));
+}
+
+void vt100_frame_end(vt100_instance_t *i) {
+    if (i->caps & VT100_CAP_SYNC) vt100_out_str_P(&i->out, PSTR("\x1B[?2026l"));
+    i->out.hold = false;
+    vt100_out_flush(&i->out);
 }
 
 void vt100_begin(vt100_instance_t *i) {
+    if (i->caps & VT100_CAP_DEC_LINES) i->charset = VT100_CS_UNKNOWN;
+    vt100_charset(i, VT100_CS_ASCII);
     vt100_format_restore(i);
     vt100_cursor(i, false);
     vt100_clear(i, ALL);
@@ -79,106 +463,606 @@ void vt100_begin(vt100_instance_t *i) {
 
 
 void vt100_end(vt100_instance_t *i) {
-    vt100_Printer_Text_Format(i->f, MODESOFF);
-    vt100_Printer_Text_Color(i->f, DEFAULT);
-    vt100_Printer_Background_Color(i->f, DEFAULT);
+    i->want.fg = DEFAULT;
+    i->want.bg = DEFAULT;
+    i->want.modes = 0;
+    vt100_sgr_sync(i);
+    vt100_charset(i, VT100_CS_ASCII);
     vt100_cursor(i, true);
     vt100_clear(i, ALL);
+    vt100_out_flush(&i->out);
 }
 
+// Both only move i->want, the terminal catches up on the next output.
 void vt100_format_set(vt100_instance_t *i) {
-    if (i->set.Default_Color != C_NOT_SET) {
-        vt100_Printer_Text_Color(i->f,  i->set.Default_Color);
-        i->set.Default_Color = C_NOT_SET;
+    vt100_attr_set(&i->want, &i->set);
+    vt100_set_clear(i);
+}
+
+void vt100_format_restore(vt100_instance_t *i) {
+    vt100_attr_def(i, &i->want);
+}
+
+void vt100_beep(vt100_instance_t *i) {
+    vt100_out_byte(&i->out, 0x07);
+}
+
+static uint8_t vt100_cup_cost(uint8_t x, uint8_t y) {
+    if (y == 1) return (x == 1) ? 3 : 3 + vt100_digits(x);
+    return 4 + vt100_digits(x) + vt100_digits(y);
+}
+
+static void vt100_csi_n(vt100_instance_t *i, uint8_t n, char final) {
+    vt100_out_csi(&i->out, (n == 1) ? 0 : n, final);
+}
+
+// Bytes needed to walk from column 'from' to 'to' on row x by printing
+// what the terminal already shows there, VT100_COST_MAX if unknown.
+static uint8_t vt100_reprint_cost(vt100_instance_t *i, uint8_t x, uint8_t from, uint8_t to) {
+    vt100_cell_t *c;
+    uint8_t cost = 0;
+    if (i->front == NULL || !i->sgr_known) return VT100_COST_MAX;
+    for (; from < to; from++) {
+        c = vt100_cell(i, i->front, x, from);
+        if (c == NULL || c->ch == VT100_CH_UNKNOWN || memcmp(&c->a, &i->sgr, sizeof(c->a)) != 0) return VT100_COST_MAX;
+        if (vt100_ch_charset(i, c->ch) != i->charset) return VT100_COST_MAX;
+        cost += vt100_ch_len(i, c->ch);
+        if (cost >= VT100_COST_MAX) return VT100_COST_MAX;
     }
-    if (i->set.Background_Color != C_NOT_SET) {
-        vt100_Printer_Background_Color(i->f, i->set.Background_Color);
-        i->set.Background_Color = C_NOT_SET;
+    return cost;
+}
+
+static void vt100_reprint(vt100_instance_t *i, uint8_t x, uint8_t from, uint8_t to) {
+    for (; from < to; from++) vt100_put_ch(i, vt100_cell(i, i->front, x, from)->ch);
+}
+
+// Forward move on the current row, reprinting or CUF whichever is shorter.
+static uint8_t vt100_forward_cost(vt100_instance_t *i, uint8_t x, uint8_t from, uint8_t to, bool *reprint) {
+    uint8_t cuf, rep;
+    *reprint = false;
+    if (to == from) return 0;
+    cuf = vt100_csi_cost(to - from);
+    rep = vt100_reprint_cost(i, x, from, to);
+    if (rep <= cuf) { *reprint = true; return rep; }
+    return cuf;
+}
+
+// The cheapest way from the tracked cursor to (x, y) among relative moves,
+// CR/LF/BS, reprinting cells and an absolute CUP, like curses mvcur. Only
+// plans: row and col say how to move, both 'H' for a CUP. Returns bytes.
+static uint8_t vt100_move_plan(vt100_instance_t *i, uint8_t x, uint8_t y, char *row, char *col, bool *rep) {
+    uint8_t best = vt100_cup_cost(x, y), rc = 0, cc = 0, d, c;
+    bool cr_rep = false;
+    *row = 0; *col = 0; *rep = false;
+    if (i->cur_known) {
+        if (x > i->cx) {
+            d = x - i->cx;
+            rc = vt100_csi_cost(d); *row = 'B';
+            if (x <= i->rows && d < rc) { rc = d; *row = '\n'; }
+        } else if (x < i->cx) {
+            rc = vt100_csi_cost(i->cx - x); *row = 'A';
+        }
+        if (y > i->cy) {
+            cc = vt100_forward_cost(i, x, i->cy, y, rep); *col = *rep ? 0 : 'C';
+        } else if (y < i->cy) {
+            d = i->cy - y;
+            cc = vt100_csi_cost(d); *col = 'D';
+            if (d < cc) { cc = d; *col = '\b'; }
+        }
+        if (y < i->cy || (*col == 'C' && !*rep)) {
+            c = 1 + vt100_forward_cost(i, x, 1, y, &cr_rep);
+            if (c < cc) { cc = c; *col = '\r'; *rep = cr_rep; }
+        }
+        if (rc + cc < best) return rc + cc;
     }
-    if (i->set.Format != F_NOT_SET) {
-        vt100_Printer_Text_Format(i->f, i->set.Format);
-        i->set.Format = F_NOT_SET;
+    *row = 'H'; *col = 'H'; *rep = false;
+    return best;
+}
+
+// Moves the cursor as vt100_move_plan says. LF is only used where the
+// shadow says the row exists, so it never scrolls; the terminal must not
+// be in newline mode (LNM), as VT100 resets it.
+uint8_t vt100_pos_x_y(vt100_instance_t *i, uint8_t x, uint8_t y) {
+    char row, col;
+    bool rep;
+    uint8_t best = vt100_move_plan(i, x, y, &row, &col, &rep), d;
+    i->move_cup_bytes += 4 + vt100_digits(x) + vt100_digits(y);
+    i->move_bytes += best;
+    if (row != 'H') {
+        if (row == '\n') { for (d = x - i->cx; d; d--) vt100_out_byte(&i->out, '\n'); }
+        else if (row) vt100_csi_n(i, (row == 'B') ? x - i->cx : i->cx - x, row);
+        i->cx = x;
+        if (col == '\r') { vt100_out_byte(&i->out, '\r'); i->cy = 1; col = rep ? 0 : 'C'; }
+        if (col == '\b') { for (d = i->cy - y; d; d--) vt100_out_byte(&i->out, '\b'); }
+        else if (col == 'C' && y > i->cy) vt100_csi_n(i, y - i->cy, 'C');
+        else if (col == 'D') vt100_csi_n(i, i->cy - y, 'D');
+        else if (rep && y > i->cy) vt100_reprint(i, x, i->cy, y);
+        i->cy = y;
+        return best;
+    }
+    if (y == 1) {
+        vt100_out_csi(&i->out, (x == 1) ? 0 : x, 'H');
+    } else {
+        vt100_out_csi2(&i->out, x, y, 'H');
     }
+    i->cx = x;
+    i->cy = y;
+    i->cur_known = true;
+    return best;
 }
 
-void vt100_format_restore(vt100_instance_t *i) {
-    vt100_Printer_Text_Format(i->f, MODESOFF);
-    vt100_Printer_Text_Format(i->f, i->def.Format);
-    vt100_Printer_Background_Color(i->f, i->def.Background_Color);
-    vt100_Printer_Text_Color(i->f, i->def.Default_Color);
+// Shadow mode only: writes text into the back grid with the pending style.
+static void vt100_shadow_str(vt100_instance_t *i, const char *txt, bool pgm) {
+    vt100_cell_t c;
+    uint8_t y = i->y1;
+    vt100_attr_def(i, &c.a);
+    vt100_attr_set(&c.a, &i->set);
+    vt100_set_clear(i);
+    while (vt100_rd((const uint8_t *)txt, pgm)) {
+        c.ch = vt100_get_ch(&txt, pgm);
+        vt100_put_cell(i, i->x1, y++, &c);
+    }
 }
 
-void vt100_beep(vt100_instance_t *i) {
-    fprintf_P(i->f, PSTR("\x07"));
+static void vt100_shadow_text(vt100_instance_t *i, const char *txt) {
+    vt100_shadow_str(i, txt, false);
 }
 
-void vt100_pos_x_y(vt100_instance_t *i, uint8_t x, uint8_t y) {
-    fprintf_P(i->f, PSTR("\x1B[%u;%uH"), x , y);
+static void vt100_shadow_text_P(vt100_instance_t *i, const char *txt) {
+    vt100_shadow_str(i, txt, true);
 }
 
 void vt100_print_text(vt100_instance_t *i, char *txt) {
+    if (i->back) { vt100_shadow_text(i, txt); return; }
     vt100_pos_x_y(i, i->x1, i->y1);
     vt100_format_set(i);
-    fputs(txt, i->f);
+    vt100_sgr_sync(i);
+    vt100_charset(i, VT100_CS_ASCII);
+    vt100_out_str(&i->out, txt);
+    vt100_advance(i, vt100_str_cells(txt));
     vt100_format_restore(i);
 }
 
 void vt100_print_text_P(vt100_instance_t *i, char *txt) {
+    if (i->back) { vt100_shadow_text_P(i, txt); return; }
     vt100_pos_x_y(i, i->x1, i->y1);
     vt100_format_set(i);
-    fputs_P(txt, i->f);
+    vt100_sgr_sync(i);
+    vt100_charset(i, VT100_CS_ASCII);
+    vt100_out_str_P(&i->out, txt);
+    vt100_advance(i, vt100_str_cells_P(txt));
     vt100_format_restore(i);
 }
 
+static void vt100_draw_begin(vt100_instance_t *i) {
+    if (i->back) {
+        vt100_attr_def(i, &i->pen);
+        vt100_attr_set(&i->pen, &i->set);
+        vt100_set_clear(i);
+    } else {
+        vt100_format_set(i);
+    }
+}
 
-void vt100_draw_box(vt100_instance_t *i) {
-    vt100_format_set(i);
-    vt100_pos_x_y(i, i->x1, i->y1); fprintf_P(i->f, PSTR("┌"));
-    vt100_pos_x_y(i, i->x1, i->y2); fprintf_P(i->f, PSTR("┐"));
-    vt100_pos_x_y(i, i->x2, i->y1); fprintf_P(i->f, PSTR("└"));
-    vt100_pos_x_y(i, i->x2, i->y2); fprintf_P(i->f, PSTR("┘"));
-    uint8_t p;
-    for (p = i->x1 + 1; p <= i->x2 - 1; ++p) {
-        vt100_pos_x_y(i, p, i->y1);
-        fprintf_P(i->f, PSTR("│"));
+static void vt100_draw_end(vt100_instance_t *i) {
+    if (i->back == NULL) vt100_format_restore(i);
+}
+
+// n copies of ch from (x, y) to the right: one cursor move in direct
+// mode, n cells of the back grid in shadow mode.
+static void vt100_hline(vt100_instance_t *i, uint8_t x, uint8_t y, uint16_t ch, uint8_t n) {
+    vt100_cell_t c;
+    if (i->back) {
+        c.ch = ch;
+        c.a = i->pen;
+        for (; n; n--, y++) vt100_put_cell(i, x, y, &c);
+        return;
     }
+    if (n == 0) return;
+    vt100_pos_x_y(i, x, y);
+    vt100_sgr_sync(i);
+    vt100_put_run(i, ch, n);
+}
+
+static void vt100_glyph(vt100_instance_t *i, uint8_t x, uint8_t y, uint16_t ch) {
+    vt100_hline(i, x, y, ch, 1);
+}
+
+// Drawn row by row, so each edge is a single run and the side walls are
+// reached with short relative moves.
+void vt100_draw_box(vt100_instance_t *i) {
+    uint8_t p, w = (i->y2 > i->y1) ? i->y2 - i->y1 - 1 : 0;
+    vt100_draw_begin(i);
+    vt100_glyph(i, i->x1, i->y1, CH_TOP_LEFT);
+    vt100_hline(i, i->x1, i->y1 + 1, CH_HORIZONTAL, w);
+    vt100_glyph(i, i->x1, i->y2, CH_TOP_RIGHT);
     for (p = i->x1 + 1; p <= i->x2 - 1; ++p) {
-        vt100_pos_x_y(i, p, i->y2);
-        fprintf_P(i->f, PSTR("│"));
+        vt100_glyph(i, p, i->y1, CH_VERTICAL);
+        vt100_glyph(i, p, i->y2, CH_VERTICAL);
     }
-    for (p = i->y1 + 1; p <= i->y2 - 1; ++p) {
-        vt100_pos_x_y(i, i->x1, p);
-        fprintf_P(i->f, PSTR("─"));
+    vt100_glyph(i, i->x2, i->y1, CH_BOTTOM_LEFT);
+    vt100_hline(i, i->x2, i->y1 + 1, CH_HORIZONTAL, w);
+    vt100_glyph(i, i->x2, i->y2, CH_BOTTOM_RIGHT);
+    vt100_draw_end(i);
+}
+
+void vt100_draw_divider(vt100_instance_t *i, vt100_divider_t dt, bool _End) {
+    uint8_t p;
+    vt100_draw_begin(i);
+    if (dt == Horizontal) {
+        if (_End == true) vt100_glyph(i, i->x1, i->y1, CH_TEE_RIGHT);
+        vt100_hline(i, i->x1, i->y1 + 1, CH_HORIZONTAL, (i->y2 > i->y1) ? i->y2 - i->y1 - 1 : 0);
+        if (_End == true) vt100_glyph(i, i->x1, i->y2, CH_TEE_LEFT);
+    } else if (dt == Vertical) {
+        if (_End == true) vt100_glyph(i, i->x1, i->y1, CH_TEE_DOWN);
+        for (p = i->x1 + 1; p <= i->x2 - 1; p++) vt100_glyph(i, p, i->y1, CH_VERTICAL);
+        if (_End == true) vt100_glyph(i, i->x2, i->y1, CH_TEE_UP);
     }
-    for (p = i->y1 + 1; p <= i->y2 - 1; ++p) {
-        vt100_pos_x_y(i, i->x2, p);
-        fprintf_P(i->f, PSTR("─"));
+    vt100_draw_end(i);
+}
+
+// Opens w on top of everything over the box i->x1..x2, i->y1..y2 and
+// selects it for drawing. What it covers goes to save, the window itself
+// starts blank in the default style. Needs the shadow.
+bool vt100_win_open(vt100_instance_t *i, vt100_win_t *w, vt100_cell_t *save) {
+    vt100_cell_t blank, *p;
+    uint8_t x, y;
+    if (i->back == NULL || i->x1 < 1 || i->y1 < 1 || i->x1 > i->x2 || i->y1 > i->y2 ||
+        i->x2 > i->rows || i->y2 > i->cols) return false;
+    w->x1 = i->x1; w->y1 = i->y1; w->x2 = i->x2; w->y2 = i->y2;
+    w->save = save;
+    blank.ch = ' ';
+    vt100_attr_def(i, &blank.a);
+    for (x = w->x1; x <= w->x2; x++) {
+        p = vt100_cell(i, i->back, x, w->y1);
+        for (y = w->y1; y <= w->y2; y++, p++) {
+            *save++ = *p;
+            *p = blank;
+        }
     }
+    w->below = i->top;
+    i->top = w;
+    i->layer = w;
+    return true;
+}
+
+// Any open window may close. Its saved cells go back where the layers
+// below would have drawn them, under windows still open above it too.
+void vt100_win_close(vt100_instance_t *i, vt100_win_t *w) {
+    vt100_win_t **link = &i->top;
+    vt100_cell_t *save = w->save;
+    uint8_t x, y;
+    while (*link && *link != w) link = &(*link)->below;
+    if (*link == NULL) return;
+    *link = w->below;
+    if (i->layer == w) i->layer = w->below;
+    for (x = w->x1; x <= w->x2; x++)
+        for (y = w->y1; y <= w->y2; y++) vt100_layer_put(i, w->below, x, y, save++);
+}
+
+// NULL draws on the screen below all windows.
+void vt100_win_select(vt100_instance_t *i, vt100_win_t *w) {
+    i->layer = w;
+}
+
+// Scrolls the box up one line through a scroll region (DECSTBM) on rows
+// x1..x2 and a LF at its bottom: the terminal moves the cells, a line costs
+// about 17 bytes whatever its width. The terminal moves whole rows, front
+// follows it, back only moves columns y1..y2, so the next flush puts back
+// what stood beside the box on its new bottom row. Without a shadow that
+// is left to the caller.
+void vt100_scroll_up(vt100_instance_t *i) {
+    vt100_cell_t blank;
+    uint8_t x, y;
     vt100_format_restore(i);
+    vt100_sgr_sync(i);  // the new row takes the current background
+    vt100_out_csi2(&i->out, i->x1, i->x2, 'r');
+    vt100_out_csi(&i->out, i->x2, 'H');
+    vt100_out_byte(&i->out, '\n');
+    vt100_out_csi(&i->out, 0, 'r');     // full screen again, homes the cursor
+    i->cx = 1; i->cy = 1; i->cur_known = true;
+    if (i->back == NULL || i->x1 >= i->x2 || i->x2 > i->rows || i->y2 > i->cols) return;
+    blank.ch = ' ';
+    blank.a = i->sgr;
+    for (x = i->x1; x <= i->x2; x++) {
+        for (y = 1; y <= i->cols; y++) {
+            if (i->front)
+                *vt100_cell(i, i->front, x, y) = (x < i->x2) ? *vt100_cell(i, i->front, x + 1, y) : blank;
+            if (y >= i->y1 && y <= i->y2)
+                *vt100_cell(i, i->back, x, y) = (x < i->x2) ? *vt100_cell(i, i->back, x + 1, y) : blank;
+        }
+    }
 }
 
-void vt100_draw_divider(vt100_instance_t *i, vt100_divider_t dt, bool _End) {
-    vt100_format_set(i);
-    if (_End == true) {
-        if (dt == Horizontal) {
-            vt100_pos_x_y(i,i->x1, i->y1); fprintf_P(i->f, PSTR("├"));
-            vt100_pos_x_y(i,i->x1, i->y2); fprintf_P(i->f, PSTR("┤"));
-        } else if (dt == Vertical) {
-            vt100_pos_x_y(i,i->x1, i->y1); fprintf_P(i->f, PSTR("┬"));
-            vt100_pos_x_y(i,i->x2, i->y1); fprintf_P(i->f, PSTR("┴"));
+// Lowest step is 1 when floor is set, so the smallest value stays visible.
+static uint16_t vt100_level(uint16_t v, uint16_t lo, uint16_t hi, uint16_t steps, bool floor) {
+    uint16_t f = floor ? 1 : 0;
+    if (v <= lo || hi <= lo) return f;
+    if (v >= hi) return steps;
+    return f + (uint32_t)(v - lo) * (steps - f) / (hi - lo);
+}
+
+// Sweep mode, like a scope: sample n of the series sits in column n % w
+// of the box i->x1,i->y1 .. i->x2,i->y2 and the column after the newest
+// stays blank. A new sample changes two columns, which is all a shadow
+// flush sends. Eighth blocks give each row 8 steps.
+void vt100_draw_sparkline(vt100_instance_t *i, const vt100_series_t *s) {
+    uint8_t h = i->x2 - i->x1 + 1, w = i->y2 - i->y1 + 1, col, r, age, newest;
+    uint16_t lo = s->lo, hi = s->hi, level;
+    uint16_t ch;
+    if (lo >= hi) { lo = vt100_series_min(s); hi = vt100_series_max(s); }
+    newest = s->total ? (s->total - 1) % w : 0;
+    vt100_draw_begin(i);
+    for (col = 0; col < w; col++) {
+        age = (newest + w - col) % w;
+        level = 0;
+        if (s->total && age < s->count && age < w - 1) level = vt100_level(vt100_series_at(s, age), lo, hi, h * 8, true);
+        for (r = 0; r < h; r++) {
+            ch = (level >= 8 * (r + 1)) ? CH_BLOCK_FULL : (level > 8 * r) ? CH_BLOCK_LOW - 1 + level - 8 * r : ' ';
+            vt100_glyph(i, i->x2 - r, i->y1 + col, ch);
         }
     }
-    uint8_t p;
-    if (dt == Horizontal) {
-        for (p = i->y1 + 1; p <= i->y2 - 1; p++) {
-            vt100_pos_x_y(i, i->x1, p);
-            fprintf_P(i->f, PSTR("─"));
+    vt100_draw_end(i);
+}
+
+// Bar of v between lo and hi on row i->x1 from i->y1 to i->y2, in eighths.
+void vt100_draw_gauge(vt100_instance_t *i, uint16_t v, uint16_t lo, uint16_t hi) {
+    uint8_t w = i->y2 - i->y1 + 1, col;
+    uint16_t level = vt100_level(v, lo, hi, w * 8, false);
+    vt100_draw_begin(i);
+    for (col = 0; col < w; col++, level = (level > 8) ? level - 8 : 0) {
+        vt100_glyph(i, i->x1, i->y1 + col, (level >= 8) ? CH_BLOCK_FULL : level ? CH_BLOCK_LEFT_0 - level : ' ');
+    }
+    vt100_draw_end(i);
+}
+
+void vt100_num_init(vt100_num_t *f, uint8_t x, uint8_t y, uint8_t width, uint8_t scale, uint8_t flags) {
+    f->x = x;
+    f->y = y;
+    f->width = (width > VT100_NUM_WIDTH) ? VT100_NUM_WIDTH : width;
+    f->scale = scale;
+    f->flags = flags;
+    vt100_num_invalidate(f);
+}
+
+// The next vt100_draw_num draws every position, after the screen under
+// the field was cleared or drawn over.
+void vt100_num_invalidate(vt100_num_t *f) {
+    memset(f->shown, 0, sizeof(f->shown));
+}
+
+// Padded to the width, a value that does not fit shows as all '#'. So
+// does every value of a scale too long for num.
+static void vt100_num_text(const vt100_num_t *f, char *txt, uint32_t v) {
+    char num[VT100_NUM_MAX];
+    uint8_t n, pad;
+    n = (f->scale <= VT100_NUM_MAX - 3) ? vt100_fixtoa(num, v, f->scale) : UINT8_MAX;
+    pad = f->width - n;
+    if (n > f->width) {
+        memset(txt, '#', f->width);
+    } else if (f->flags & VT100_NUM_LEFT) {
+        memcpy(txt, num, n);
+        memset(txt + n, ' ', pad);
+    } else {
+        memset(txt, (f->flags & VT100_NUM_ZEROS) ? '0' : ' ', pad);
+        memcpy(txt + pad, num, n);
+    }
+}
+
+// Draws only the positions that differ from what the field shows, with
+// the style in i->set. Changed positions closer than a cursor move are
+// sent as one run, each run costs one vt100_pos_x_y in direct mode. A
+// style change redraws the whole field.
+void vt100_draw_num(vt100_instance_t *i, vt100_num_t *f, uint32_t v) {
+    char txt[VT100_NUM_WIDTH];
+    vt100_cell_t c;
+    uint8_t k, n, m, gap;
+    vt100_attr_def(i, &c.a);
+    vt100_attr_set(&c.a, &i->set);
+    vt100_set_clear(i);
+    if (memcmp(&c.a, &f->a, sizeof(c.a)) != 0) {
+        f->a = c.a;
+        vt100_num_invalidate(f);
+    }
+    vt100_num_text(f, txt, v);
+    for (k = 0; k < f->width; k += n) {
+        n = 1;
+        if (txt[k] == f->shown[k]) continue;
+        for (gap = 0; k + n < f->width && gap < 3; n++)
+            gap = (txt[k + n] == f->shown[k + n]) ? gap + 1 : 0;
+        n -= gap;
+        if (i->back) {
+            for (m = 0; m < n; m++) {
+                c.ch = txt[k + m];
+                vt100_put_cell(i, f->x, f->y + k + m, &c);
+            }
+            continue;
         }
-    } else if (dt == Vertical) {
-        for (p = i->x1 + 1; p <= i->x2 - 1; p++) {
-            vt100_pos_x_y(i, p, i->y1);
-            fprintf_P(i->f, PSTR("│"));
+        vt100_pos_x_y(i, f->x, f->y + k);
+        i->want = c.a;
+        vt100_sgr_sync(i);
+        vt100_charset(i, VT100_CS_ASCII);
+        vt100_out_data(&i->out, (const uint8_t *)txt + k, n);
+        vt100_advance(i, n);
+    }
+    memcpy(f->shown, txt, f->width);
+    if (i->back == NULL) vt100_format_restore(i);
+}
+
+// What the link carries in one frame becomes the flush budget.
+void vt100_link(vt100_instance_t *i, uint32_t bytes_per_sec, uint8_t fps) {
+    uint32_t b = fps ? bytes_per_sec / fps : 0;
+    i->link = (b > UINT16_MAX) ? 0 : b;
+    if (bytes_per_sec && fps && i->link == 0) i->link = 1;
+    i->budget = i->link;
+}
+
+void vt100_regions(vt100_instance_t *i, const vt100_region_t *r, uint8_t n) {
+    i->regions = r;
+    i->nregions = n;
+}
+
+// First region holding the cell, the slot of everything else if none.
+static uint8_t vt100_region_of(vt100_instance_t *i, uint8_t x, uint8_t y) {
+    const vt100_region_t *r;
+    uint8_t k;
+    for (k = 0; k < i->nregions && k < VT100_STATS_REGIONS; k++) {
+        r = &i->regions[k];
+        if (x >= r->x1 && x <= r->x2 && y >= r->y1 && y <= r->y2) return k;
+    }
+    return VT100_STATS_REGIONS;
+}
+
+// Sends the dirty cells of a rectangle, false once a run would pass stop.
+// The first run of a flush always goes, cut to the budget but at least one
+// cell, so a tiny budget still progresses.
+static bool vt100_flush_rect(vt100_instance_t *i, uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint32_t stop) {
+    uint32_t start, cut;
+    uint8_t x, y, n, len, extra;
+    char row, col;
+    bool rep;
+    if (x2 > i->rows) x2 = i->rows;
+    if (y2 > i->cols) y2 = i->cols;
+    for (x = x1; x <= x2; x++) {
+        vt100_cell_t *b = vt100_cell(i, i->back, x, 1);
+        vt100_cell_t *f = vt100_cell(i, i->front, x, 1);
+        for (y = y1 - 1; y < y2; y += n) {
+            n = 1;
+            if (vt100_cell_eq(&b[y], &f[y])) continue;
+            while (y + n < y2 && vt100_cell_eq(&b[y + n], &b[y]) && !vt100_cell_eq(&b[y + n], &f[y + n])) n++;
+            len = vt100_ch_len(i, b[y].ch);
+            if (i->budget) {
+                // The run with the move, the SGR change and the charset switch before it
+                extra = vt100_move_plan(i, x, y + 1, &row, &col, &rep) + vt100_sgr_delta(i, &b[y].a, false);
+                if (vt100_ch_charset(i, b[y].ch) != i->charset) extra += 3;
+                if ((int32_t)(i->out.bytes + extra + (uint32_t)n * len - stop) > 0) {
+                    if (i->out.bytes != stop - i->budget) return false;
+                    cut = (stop - i->out.bytes > extra) ? (stop - i->out.bytes - extra) / len : 0;
+                    n = (cut == 0) ? 1 : cut;
+                }
+            }
+            start = i->out.bytes;
+            vt100_pos_x_y(i, x, y + 1);
+            i->want = b[y].a;
+            vt100_sgr_sync(i);
+            vt100_put_run(i, b[y].ch, n);
+            memcpy(&f[y], &b[y], n * sizeof(vt100_cell_t));
+            i->stats.region_now[vt100_region_of(i, x, y + 1)] += i->out.bytes - start;
         }
     }
+    return true;
+}
+
+// Sends every back cell that differs from front, identical neighbours as
+// one vt100_put_run. Short stretches of unchanged cells between two runs
+// are bridged by vt100_pos_x_y, which reprints them when that is cheaper
+// than a cursor move.
+void vt100_flush(vt100_instance_t *i) {
+    const vt100_region_t *r;
+    uint32_t stop = i->out.bytes + i->budget;
+    uint16_t last = 0x100;
+    uint8_t prio, k;
+    bool more = i->budget != 0, sent = true;
+    if (i->back == NULL || i->front == NULL) { vt100_out_flush(&i->out); return; }
+    // Regions by falling prio, equal ones in table order, then the rest.
+    // Without a budget everything goes out anyway, row by row is cheapest.
+    while (sent && more) {
+        for (more = false, prio = 0, k = 0; k < i->nregions; k++) {
+            if (i->regions[k].prio < last && i->regions[k].prio >= prio) { prio = i->regions[k].prio; more = true; }
+        }
+        for (k = 0; more && sent && k < i->nregions; k++) {
+            r = &i->regions[k];
+            if (r->prio == prio) sent = vt100_flush_rect(i, r->x1, r->y1, r->x2, r->y2, stop);
+        }
+        last = prio;
+    }
+    if (sent) sent = vt100_flush_rect(i, 1, 1, i->rows, i->cols, stop);
+    i->behind = !sent;
     vt100_format_restore(i);
+    vt100_out_flush(&i->out);
+}
+
+void vt100_stats_begin(vt100_instance_t *i, uint32_t now_us) {
+    vt100_stats_t *st = &i->stats;
+    st->t0 = now_us;
+    st->out_bytes = i->out.bytes;
+    st->out_escapes = i->out.escapes;
+    st->out_writes = i->out.writes;
+    st->out_flushes = i->out.flushes;
+    memset(st->region_now, 0, sizeof(st->region_now));
+}
+
+void vt100_stats_end(vt100_instance_t *i, uint32_t now_us) {
+    vt100_stats_t *st = &i->stats;
+    st->frames++;
+    st->bytes = i->out.bytes - st->out_bytes;
+    st->escapes = i->out.escapes - st->out_escapes;
+    st->writes = i->out.writes - st->out_writes;
+    st->flushes = i->out.flushes - st->out_flushes;
+    st->render_us = now_us - st->t0;
+    memcpy(st->region_bytes, st->region_now, sizeof(st->region_bytes));
+    if (st->bytes > st->bytes_max) st->bytes_max = st->bytes;
+    if (st->render_us > st->render_us_max) st->render_us_max = st->render_us;
+}
+
+void vt100_stats_key(vt100_instance_t *i, uint32_t latency_us) {
+    i->stats.keys++;
+    i->stats.key_us = latency_us;
+    if (latency_us > i->stats.key_us_max) i->stats.key_us_max = latency_us;
+}
+
+static uint8_t vt100_cat_P(char *buf, uint8_t n, uint8_t w, const char *s) {
+    char c;
+    while (n < w && (c = pgm_read_byte(s++)) != 0) buf[n++] = c;
+    return n;
+}
+
+// v right aligned in a field of f columns
+static uint8_t vt100_cat_num(char *buf, uint8_t n, uint8_t w, uint32_t v, uint8_t f) {
+    char num[VT100_NUM_MAX];
+    uint8_t k, len = vt100_utoa(num, v);
+    for (k = len; k < f && n < w; k++) buf[n++] = ' ';
+    for (k = 0; k < len && n < w; k++) buf[n++] = num[k];
+    return n;
+}
+
+// One row of the overlay: label and tag, a value and its unit, then
+// optionally a second pair, padded to the width. No label, blank row.
+static void vt100_stats_row(vt100_instance_t *i, uint8_t x, uint8_t y, uint8_t w, const char *label, char tag,
+                            uint32_t a, const char *ua, uint32_t b, const char *ub) {
+    char buf[VT100_COLS_DEFAULT + 1];
+    uint8_t n = 0;
+    if (w > VT100_COLS_DEFAULT) w = VT100_COLS_DEFAULT;
+    if (label) {
+        n = vt100_cat_P(buf, n, w, label);
+        if (tag && n < w) buf[n++] = tag;
+        n = vt100_cat_num(buf, n, w, a, 7);
+        n = vt100_cat_P(buf, n, w, ua);
+    }
+    if (label && ub) {
+        n = vt100_cat_num(buf, n, w, b, 7);
+        n = vt100_cat_P(buf, n, w, ub);
+    }
+    while (n < w) buf[n++] = ' ';
+    buf[n] = 0;
+    i->x1 = x; i->y1 = y;
+    vt100_print_text(i, buf);
+}
+
+// Overlay in the box i->x1..x2 and i->y1..y2 with the counters of the last
+// frame, one row per region below them as far as the box goes.
+void vt100_draw_stats(vt100_instance_t *i) {
+    vt100_stats_t *st = &i->stats;
+    uint8_t y = i->y1 + 1, x2 = i->x2, w = i->y2 - i->y1 - 1, x = i->x1 + 1, k;
+    vt100_draw_box(i);
+    vt100_stats_row(i, x++, y, w, PSTR("frame "), 0, st->bytes, PSTR(" B"), st->escapes, PSTR(" esc"));
+    vt100_stats_row(i, x++, y, w, PSTR("write "), 0, st->writes, PSTR("  "), st->flushes, PSTR(" flush"));
+    vt100_stats_row(i, x++, y, w, PSTR("render"), 0, st->render_us, PSTR(" us"), st->render_us_max, PSTR(" max"));
+    vt100_stats_row(i, x++, y, w, PSTR("key   "), 0, st->key_us, PSTR(" us"), st->key_us_max, PSTR(" max"));
+    for (k = 0; k <= VT100_STATS_REGIONS && x < x2; k++) {
+        if (k < VT100_STATS_REGIONS && k >= i->nregions) continue;
+        vt100_stats_row(i, x++, y, w, PSTR("area "), (k < VT100_STATS_REGIONS) ? '1' + k : '*',
+                        st->region_bytes[k], PSTR(" B"), 0, NULL);
+    }
+    for (; x < x2; x++) vt100_stats_row(i, x, y, w, NULL, 0, 0, NULL, 0, NULL);
 }
@@ -23,16 +23,10 @@
  */
 
 #pragma once
-#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
-
-#define F(x)    (x)
-#define PSTR(x) (x)
-#define PROGMEM
-#define printf_P printf
-#define fprintf_P fprintf
-#define fputs_P fputs
+#include "vt100_out.h"
+#include "vt100_series.h"
 
 typedef enum  {
     C_NOT_SET     = 0,
@@ -78,26 +72,178 @@ typedef struct {
     vt100_format_t Format;
 } vt100_ccf_t;
 
+// Attributes as the terminal sees them. Bit n of modes is SGR n+1,
+// i.e. bit (Format - 2) of a vt100_format_t above MODESOFF.
+typedef struct {
+    uint8_t fg;
+    uint8_t bg;
+    uint8_t modes;
+} vt100_attr_t;
+
+typedef struct {
+    uint16_t     ch;    // UCS-2 code point, VT100_CH_UNKNOWN forces a repaint
+    vt100_attr_t a;
+} vt100_cell_t;
+
+#define VT100_CH_UNKNOWN 0xFFFF
+
+// Assumed terminal width when no shadow tells the real one.
+#define VT100_COLS_DEFAULT 80
+#define VT100_COST_MAX     255
+
+// vt100_instance_t.caps, what the terminal on the other end understands
+#define VT100_CAP_DEC_LINES 0x01    // boxes from DEC Special Graphics (ESC(0)
+#define VT100_CAP_REP       0x02    // ESC[nb repeats the last character
+#define VT100_CAP_SYNC      0x04    // synchronized update, ESC[?2026h/l
+
+#define VT100_SYNC_BYTES 16         // both brackets of a synchronized frame
+
+#define VT100_CS_ASCII    0
+#define VT100_CS_GRAPHICS 1
+#define VT100_CS_UNKNOWN  2
+
+// A part of the screen the shadow flush sends before the rest, higher
+// prio first. Cells outside every region go last.
+typedef struct {
+    uint8_t x1;
+    uint8_t y1;
+    uint8_t x2;
+    uint8_t y2;
+    uint8_t prio;
+} vt100_region_t;
+
+// Counters of one instance, cheap enough to leave on. The frame fields
+// describe the last frame between vt100_stats_begin and vt100_stats_end,
+// times come from the caller's microsecond clock.
+#define VT100_STATS_REGIONS 8
+
+typedef struct {
+    uint32_t frames;
+    uint16_t bytes;         // last frame
+    uint16_t escapes;
+    uint16_t writes;
+    uint16_t flushes;
+    uint16_t bytes_max;     // worst frame so far
+    uint32_t render_us;
+    uint32_t render_us_max;
+    uint32_t keys;
+    uint32_t key_us;        // last key, from its first byte to the application
+    uint32_t key_us_max;
+    // Shadow flush bytes of the frame by vt100_regions entry, cells outside
+    // of the first VT100_STATS_REGIONS in the last slot.
+    uint16_t region_bytes[VT100_STATS_REGIONS + 1];
+    uint16_t region_now[VT100_STATS_REGIONS + 1];   // of the frame going on
+    uint32_t t0;            // state at vt100_stats_begin
+    uint32_t out_bytes;
+    uint32_t out_escapes;
+    uint32_t out_writes;
+    uint32_t out_flushes;
+} vt100_stats_t;
+
+// A window over the shadow screen, a popup or a menu. While it is open,
+// drawing from layers below it lands in save instead of the cells it
+// covers, and closing it puts save back: only its own rectangle changes.
+typedef struct vt100_win {
+    struct vt100_win *below;
+    uint8_t x1;
+    uint8_t y1;
+    uint8_t x2;
+    uint8_t y2;
+    vt100_cell_t *save;     // rows x cols cells of the window, caller supplied
+} vt100_win_t;
+
+#define VT100_WIN_CELLS(x1, y1, x2, y2) (((x2) - (x1) + 1) * ((y2) - (y1) + 1))
+
+// A number in a fixed-width field from x, y to the right. shown is what
+// the field last drew there, so an update sends only the digits that
+// changed, and the padding clears what a longer value left behind.
+#ifndef VT100_NUM_WIDTH
+#define VT100_NUM_WIDTH 8   // widest field, RAM of every vt100_num_t
+#endif
+
+#define VT100_NUM_LEFT  0x01    // left aligned, right aligned otherwise
+#define VT100_NUM_ZEROS 0x02    // right aligned with leading zeros
+
+typedef struct {
+    uint8_t x;
+    uint8_t y;
+    uint8_t width;
+    uint8_t scale;      // digits after the point, 3 shows millivolts as volts
+    uint8_t flags;
+    vt100_attr_t a;     // style of shown
+    char shown[VT100_NUM_WIDTH];    // 0 where unknown
+} vt100_num_t;
+
 typedef struct {
-    FILE    *f;
+    vt100_out_t out;
     vt100_ccf_t def;
     vt100_ccf_t set;
     uint8_t x1;
     uint8_t y1;
     uint8_t x2;
     uint8_t y2;
+    // Optional shadow framebuffer, x is the row and y the column as in
+    // vt100_pos_x_y. front mirrors the terminal, back is drawn into.
+    vt100_cell_t *front;
+    vt100_cell_t *back;
+    uint8_t rows;
+    uint8_t cols;
+    vt100_attr_t pen;   // style of the box being drawn into back
+    vt100_attr_t want;  // style the next output should have
+    vt100_attr_t sgr;   // style the terminal has, valid if sgr_known
+    bool sgr_known;
+    uint8_t cx;         // tracked cursor row, valid if cur_known
+    uint8_t cy;         // tracked cursor column
+    bool cur_known;
+    uint8_t caps;
+    uint8_t charset;    // G0 as last designated, VT100_CS_*
+    uint32_t move_bytes;     // sent by vt100_pos_x_y so far
+    uint32_t move_cup_bytes; // what an absolute ESC[x;yH every time would cost
+    const vt100_region_t *regions;
+    uint8_t nregions;
+    uint16_t budget;    // bytes one shadow flush may send, 0 = unlimited
+    uint16_t link;      // budget vt100_link set, vt100_tx_frame lowers budget from it
+    bool behind;        // the last flush left dirty cells for the next one
+    vt100_stats_t stats;
+    vt100_win_t *top;   // open windows, the topmost first
+    vt100_win_t *layer; // window drawn into, NULL for the screen below all
 } vt100_instance_t;
 
 void vt100_init(vt100_instance_t *i);
+void vt100_frame_begin(vt100_instance_t *i);
+void vt100_frame_end(vt100_instance_t *i);
 void vt100_begin(vt100_instance_t *i);
 void vt100_end(vt100_instance_t *i);
 void vt100_clear(vt100_instance_t *i, vt100_clear_t t);
 void vt100_cursor(vt100_instance_t *i, bool cursor);
+void vt100_paste_mode(vt100_instance_t *i, bool paste);
 void vt100_format_set(vt100_instance_t *i);
 void vt100_format_restore(vt100_instance_t *i);
 void vt100_beep(vt100_instance_t *i);
-void vt100_pos_x_y(vt100_instance_t *i, uint8_t x, uint8_t y);
+uint8_t vt100_pos_x_y(vt100_instance_t *i, uint8_t x, uint8_t y);
 void vt100_print_text(vt100_instance_t *i, char *txt);
 void vt100_print_text_P(vt100_instance_t *i, char *txt);
 void vt100_draw_box(vt100_instance_t *i);
 void vt100_draw_divider(vt100_instance_t *i, vt100_divider_t dt, bool _End);
+void vt100_scroll_up(vt100_instance_t *i);
+void vt100_draw_sparkline(vt100_instance_t *i, const vt100_series_t *s);
+void vt100_draw_gauge(vt100_instance_t *i, uint16_t v, uint16_t lo, uint16_t hi);
+void vt100_num_init(vt100_num_t *f, uint8_t x, uint8_t y, uint8_t width, uint8_t scale, uint8_t flags);
+void vt100_num_invalidate(vt100_num_t *f);
+void vt100_draw_num(vt100_instance_t *i, vt100_num_t *f, uint32_t v);
+void vt100_shadow(vt100_instance_t *i, vt100_cell_t *front, vt100_cell_t *back, uint8_t rows, uint8_t cols);
+void vt100_share(vt100_instance_t *i, vt100_cell_t *front, const vt100_instance_t *owner);
+void vt100_resize(vt100_instance_t *i, uint8_t rows, uint8_t cols);
+void vt100_query_size(vt100_instance_t *i);
+void vt100_invalidate(vt100_instance_t *i);
+void vt100_commit(vt100_instance_t *i);
+void vt100_link(vt100_instance_t *i, uint32_t bytes_per_sec, uint8_t fps);
+void vt100_regions(vt100_instance_t *i, const vt100_region_t *r, uint8_t n);
+void vt100_flush(vt100_instance_t *i);
+bool vt100_win_open(vt100_instance_t *i, vt100_win_t *w, vt100_cell_t *save);
+void vt100_win_close(vt100_instance_t *i, vt100_win_t *w);
+void vt100_win_select(vt100_instance_t *i, vt100_win_t *w);
+void vt100_stats_begin(vt100_instance_t *i, uint32_t now_us);
+void vt100_stats_end(vt100_instance_t *i, uint32_t now_us);
+void vt100_stats_key(vt100_instance_t *i, uint32_t latency_us);
+void vt100_draw_stats(vt100_instance_t *i);
@@ -0,0 +1,169 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "vt100_rec.h"
+
+static uint64_t vt100_rec_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static void vt100_rec_write(vt100_rec_t *r, const uint8_t *data, size_t len) {
+    ssize_t n;
+    while (len && r->fd >= 0) {
+        if ((n = write(r->fd, data, len)) <= 0) { close(r->fd); r->fd = -1; return; }
+        data += n;
+        len -= n;
+    }
+}
+
+static void vt100_rec_drain(vt100_rec_t *r) {
+    vt100_rec_write(r, r->buf, r->len);
+    r->len = 0;
+}
+
+static uint8_t vt100_rec_varint(uint8_t *p, uint64_t v) {
+    uint8_t n = 0;
+    while (v >= 0x80) { p[n++] = (v & 0x7F) | 0x80; v >>= 7; }
+    p[n++] = v;
+    return n;
+}
+
+bool vt100_rec_open(vt100_rec_t *r, const char *path, vt100_sink_t next, void *next_ctx) {
+    r->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (r->fd < 0) return false;
+    r->t0_us = vt100_rec_now();
+    r->last_us = 0;
+    r->records = 0;
+    r->bytes = 0;
+    r->next = next;
+    r->next_ctx = next_ctx;
+    pthread_mutex_init(&r->lock, NULL);
+    memcpy(r->buf, VT100_REC_MAGIC, 4);
+    r->len = 4;
+    return true;
+}
+
+// Chunks that do not fit the buffer go to the file directly behind it.
+void vt100_rec_put(vt100_rec_t *r, uint8_t stream, const uint8_t *data, uint16_t len) {
+    uint8_t head[1 + 10 + 3];
+    uint64_t at;
+    uint8_t n;
+    pthread_mutex_lock(&r->lock);
+    at = vt100_rec_now() - r->t0_us;
+    head[0] = stream;
+    n = 1 + vt100_rec_varint(head + 1, at - r->last_us);
+    n += vt100_rec_varint(head + n, len);
+    r->last_us = at;
+    r->records++;
+    r->bytes += len;
+    if (r->len + n + len > VT100_REC_BUF) vt100_rec_drain(r);
+    memcpy(r->buf + r->len, head, n);
+    r->len += n;
+    if (r->len + len > VT100_REC_BUF) {
+        vt100_rec_drain(r);
+        vt100_rec_write(r, data, len);
+    } else {
+        memcpy(r->buf + r->len, data, len);
+        r->len += len;
+    }
+    pthread_mutex_unlock(&r->lock);
+}
+
+// Output sink: records what the library sends and passes it on.
+void vt100_rec_sink(void *ctx, const uint8_t *data, uint16_t len) {
+    vt100_rec_t *r = ctx;
+    vt100_rec_put(r, VT100_REC_OUT, data, len);
+    if (r->next) r->next(r->next_ctx, data, len);
+}
+
+void vt100_rec_close(vt100_rec_t *r) {
+    pthread_mutex_lock(&r->lock);
+    vt100_rec_drain(r);
+    if (r->fd >= 0) close(r->fd);
+    r->fd = -1;
+    pthread_mutex_unlock(&r->lock);
+}
+
+bool vt100_play_open(vt100_play_t *p, const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    p->map = NULL;
+    if (fd < 0) return false;
+    if (fstat(fd, &st) == 0 && st.st_size >= 4) {
+        p->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p->map == MAP_FAILED) p->map = NULL;
+    }
+    close(fd);
+    if (p->map == NULL) return false;
+    p->size = st.st_size;
+    if (memcmp(p->map, VT100_REC_MAGIC, 4)) { vt100_play_close(p); return false; }
+    madvise((void *)p->map, p->size, MADV_SEQUENTIAL);
+    vt100_play_rewind(p);
+    return true;
+}
+
+static bool vt100_play_varint(vt100_play_t *p, uint64_t *v) {
+    uint8_t shift = 0, c;
+    *v = 0;
+    do {
+        if (p->pos >= p->size || shift > 63) return false;
+        c = p->map[p->pos++];
+        *v |= (uint64_t)(c & 0x7F) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    return true;
+}
+
+// False at the end, or at a record cut short by a crash while recording.
+bool vt100_play_next(vt100_play_t *p, vt100_rec_event_t *ev) {
+    uint64_t dt, len;
+    if (p->pos >= p->size) return false;
+    ev->stream = p->map[p->pos++];
+    if (!vt100_play_varint(p, &dt) || !vt100_play_varint(p, &len)) return false;
+    if (len > p->size - p->pos) return false;
+    p->at_us += dt;
+    ev->at_us = p->at_us;
+    ev->data = p->map + p->pos;
+    ev->len = len;
+    p->pos += len;
+    return true;
+}
+
+void vt100_play_rewind(vt100_play_t *p) {
+    p->pos = 4;
+    p->at_us = 0;
+}
+
+void vt100_play_close(vt100_play_t *p) {
+    if (p->map) munmap((void *)p->map, p->size);
+    p->map = NULL;
+}
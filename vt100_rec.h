@@ -0,0 +1,78 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "vt100_out.h"
+
+// POSIX only: session recording. What the terminal sent and what the
+// library sent back go into one file, each chunk as a record of the
+// stream byte, the microseconds since the record before and the length,
+// both LEB128 varints, followed by the data. A replay maps the file and
+// hands out records that point into the mapping, nothing gets copied.
+
+#define VT100_REC_MAGIC "VTR1"
+#define VT100_REC_IN    'I'     // bytes from the terminal
+#define VT100_REC_OUT   'O'     // bytes to the terminal
+#define VT100_REC_BUF   4096
+
+typedef struct {
+    int fd;
+    uint64_t t0_us;         // CLOCK_MONOTONIC at open
+    uint64_t last_us;       // time of the last record since t0
+    uint32_t records;
+    uint64_t bytes;         // data recorded, without the record headers
+    pthread_mutex_t lock;   // input and output come from different threads
+    vt100_sink_t next;      // vt100_rec_sink passes the output on to it
+    void *next_ctx;
+    uint16_t len;
+    uint8_t buf[VT100_REC_BUF];
+} vt100_rec_t;
+
+typedef struct {
+    uint8_t stream;         // VT100_REC_IN or VT100_REC_OUT
+    uint64_t at_us;         // since the recording started
+    const uint8_t *data;    // inside the mapping
+    uint32_t len;
+} vt100_rec_event_t;
+
+typedef struct {
+    const uint8_t *map;
+    size_t size;
+    size_t pos;
+    uint64_t at_us;
+} vt100_play_t;
+
+bool vt100_rec_open(vt100_rec_t *r, const char *path, vt100_sink_t next, void *next_ctx);
+void vt100_rec_put(vt100_rec_t *r, uint8_t stream, const uint8_t *data, uint16_t len);
+void vt100_rec_sink(void *ctx, const uint8_t *data, uint16_t len);
+void vt100_rec_close(vt100_rec_t *r);
+
+bool vt100_play_open(vt100_play_t *p, const char *path);
+bool vt100_play_next(vt100_play_t *p, vt100_rec_event_t *ev);
+void vt100_play_rewind(vt100_play_t *p);
+void vt100_play_close(vt100_play_t *p);
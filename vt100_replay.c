@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Plays a recording made with vt100_rec: the input through the key
+// decoder, the output through the terminal model, at the recorded pace
+// or as fast as they go.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "vt100_input.h"
+#include "vt100_model.h"
+#include "vt100_rec.h"
+
+#define ROWS_MAX 255
+#define COLS_MAX 255
+
+static vt100_cell_t cells[ROWS_MAX * COLS_MAX];
+static uint32_t keys;
+
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+static void key_cb(void *ctx, const vt100_key_event_t *ev) {
+    keys++;
+}
+
+static void put_utf8(uint16_t ch) {
+    if (ch < 0x80) putchar(ch);
+    else if (ch < 0x800) { putchar(0xC0 | ch >> 6); putchar(0x80 | (ch & 0x3F)); }
+    else { putchar(0xE0 | ch >> 12); putchar(0x80 | (ch >> 6 & 0x3F)); putchar(0x80 | (ch & 0x3F)); }
+}
+
+static void print_screen(vt100_model_t *m) {
+    for (uint8_t x = 1; x <= m->rows; x++) {
+        for (uint8_t y = 1; y <= m->cols; y++) put_utf8(vt100_model_cell(m, x, y)->ch);
+        putchar('\n');
+    }
+}
+
+int main(int argc, char **argv) {
+    vt100_play_t p;
+    vt100_rec_event_t ev;
+    vt100_parser_t kbd;
+    vt100_model_t m;
+    uint64_t t0, t, in_ns = 0, out_ns = 0, in_b = 0, out_b = 0, wall;
+    struct timespec due;
+    int opt, rows = 24, cols = 80, loops = 1, n;
+    bool paced = false, screen = false;
+
+    while ((opt = getopt(argc, argv, "rsn:g:")) != -1) {
+        switch (opt) {
+            case 'r': paced = true;                                 break;
+            case 's': screen = true;                                break;
+            case 'n': loops = atoi(optarg);                         break;
+            case 'g': if (sscanf(optarg, "%dx%d", &rows, &cols) != 2) rows = 0; break;
+            default:
+                fprintf(stderr, "usage: %s [-r] [-s] [-n loops] [-g rowsxcols] file\n"
+                                "  -r  at the recorded pace, otherwise as fast as it goes\n"
+                                "  -s  print the screen the output leaves\n"
+                                "  -n  play it that many times\n"
+                                "  -g  terminal size, 24x80 if not given\n", argv[0]);
+                exit(1);
+        }
+    }
+    if (optind >= argc || rows < 1 || rows > ROWS_MAX || cols < 1 || cols > COLS_MAX) {
+        fprintf(stderr, "%s: a recording and a size up to %dx%d, please\n", argv[0], ROWS_MAX, COLS_MAX);
+        exit(1);
+    }
+    if (!vt100_play_open(&p, argv[optind])) { perror(argv[optind]); exit(1); }
+
+    wall = now_ns();
+    for (n = 0; n < loops; n++) {
+        vt100_parser_init(&kbd);
+        vt100_model_init(&m, cells, rows, cols);
+        vt100_play_rewind(&p);
+        t0 = now_ns();
+        while (vt100_play_next(&p, &ev)) {
+            if (paced) {
+                t = t0 + ev.at_us * 1000;
+                due.tv_sec = t / 1000000000;
+                due.tv_nsec = t % 1000000000;
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+            }
+            t = now_ns();
+            if (ev.stream == VT100_REC_IN) {
+                for (uint32_t k = 0; k < ev.len; k += 0xFFFF)
+                    vt100_parse(&kbd, ev.data + k, ev.len - k > 0xFFFF ? 0xFFFF : ev.len - k, key_cb, NULL);
+                in_ns += now_ns() - t;
+                in_b += ev.len;
+            } else if (ev.stream == VT100_REC_OUT) {
+                vt100_model_feed(&m, ev.data, ev.len);
+                out_ns += now_ns() - t;
+                out_b += ev.len;
+            }
+        }
+    }
+    wall = now_ns() - wall;
+
+    if (screen) print_screen(&m);
+    printf("input    %10llu B %8u keys  %8.1f MB/s decoded\n", (unsigned long long)in_b, keys,
+           in_ns ? in_b * 1000.0 / in_ns : 0.0);
+    printf("output   %10llu B %8u unknown  %5.1f MB/s through the model\n", (unsigned long long)out_b, m.unknown,
+           out_ns ? out_b * 1000.0 / out_ns : 0.0);
+    printf("session  %10.3f s recorded, played %d times in %.3f s\n", p.at_us / 1e6, loops, wall / 1e9);
+    vt100_play_close(&p);
+    return 0;
+}
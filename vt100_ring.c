@@ -0,0 +1,85 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "vt100_ring.h"
+
+#define LOAD_ACQ(p)     __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+void vt100_ring_init(vt100_ring_t *r, uint8_t *buf, vt100_idx_t size) {
+    r->buf = buf;
+    r->mask = size - 1;
+    r->head = 0;
+    r->tail = 0;
+    r->overflow = 0;
+}
+
+bool vt100_ring_put(vt100_ring_t *r, uint8_t c) {
+    vt100_idx_t head = r->head, next = (head + 1) & r->mask;
+    if (next == LOAD_ACQ(&r->tail)) {
+        r->overflow++;
+        return false;
+    }
+    r->buf[head] = c;
+    STORE_REL(&r->head, next);
+    return true;
+}
+
+// Stores as much as fits and publishes it with a single head update.
+vt100_idx_t vt100_ring_write(vt100_ring_t *r, const uint8_t *data, vt100_idx_t len) {
+    vt100_idx_t head = r->head, tail = LOAD_ACQ(&r->tail), n = 0;
+    while (n < len && ((head + 1) & r->mask) != tail) {
+        r->buf[head] = data[n++];
+        head = (head + 1) & r->mask;
+    }
+    r->overflow += len - n;
+    STORE_REL(&r->head, head);
+    return n;
+}
+
+bool vt100_ring_get(vt100_ring_t *r, uint8_t *c) {
+    vt100_idx_t tail = r->tail;
+    if (tail == LOAD_ACQ(&r->head)) return false;
+    *c = r->buf[tail];
+    STORE_REL(&r->tail, (tail + 1) & r->mask);
+    return true;
+}
+
+vt100_idx_t vt100_ring_read(vt100_ring_t *r, uint8_t *data, vt100_idx_t len) {
+    vt100_idx_t tail = r->tail, head = LOAD_ACQ(&r->head), n = 0;
+    while (n < len && tail != head) {
+        data[n++] = r->buf[tail];
+        tail = (tail + 1) & r->mask;
+    }
+    STORE_REL(&r->tail, tail);
+    return n;
+}
+
+vt100_idx_t vt100_ring_count(vt100_ring_t *r) {
+    return (LOAD_ACQ(&r->head) - LOAD_ACQ(&r->tail)) & r->mask;
+}
+
+vt100_idx_t vt100_ring_free(vt100_ring_t *r) {
+    return r->mask - vt100_ring_count(r);
+}
@@ -0,0 +1,53 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Single producer, single consumer byte ring. The producer (an RX ISR or
+// an input thread) only moves head, the consumer only moves tail, so
+// neither side needs to lock. One slot stays empty to tell full from empty.
+
+#ifdef __AVR__
+typedef uint8_t  vt100_idx_t;   // loads and stores of one byte are atomic
+#else
+typedef uint16_t vt100_idx_t;
+#endif
+
+typedef struct {
+    uint8_t     *buf;
+    vt100_idx_t mask;       // size - 1, size must be a power of two
+    vt100_idx_t head;
+    vt100_idx_t tail;
+    uint16_t    overflow;   // bytes the producer dropped on a full ring
+} vt100_ring_t;
+
+void vt100_ring_init(vt100_ring_t *r, uint8_t *buf, vt100_idx_t size);
+bool vt100_ring_put(vt100_ring_t *r, uint8_t c);
+vt100_idx_t vt100_ring_write(vt100_ring_t *r, const uint8_t *data, vt100_idx_t len);
+bool vt100_ring_get(vt100_ring_t *r, uint8_t *c);
+vt100_idx_t vt100_ring_read(vt100_ring_t *r, uint8_t *data, vt100_idx_t len);
+vt100_idx_t vt100_ring_count(vt100_ring_t *r);
+vt100_idx_t vt100_ring_free(vt100_ring_t *r);
@@ -0,0 +1,149 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "vt100_sched.h"
+#include <string.h>
+#ifndef __AVR__
+#include <poll.h>
+#include <time.h>
+#endif
+
+#define WHEEL_MASK (VT100_WHEEL_SLOTS - 1)
+
+static void vt100_sched_insert(vt100_sched_t *s, vt100_timer_t *t) {
+    uint8_t slot = (s->now + t->period) & WHEEL_MASK;
+    t->rounds = (t->period - 1) / VT100_WHEEL_SLOTS;
+    t->next = s->slot[slot];
+    s->slot[slot] = t;
+}
+
+#ifndef __AVR__
+static uint32_t vt100_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000UL;
+}
+#endif
+
+void vt100_sched_init(vt100_sched_t *s, uint16_t tick_ms) {
+    memset(s, 0, sizeof(*s));
+    s->tick_ms = tick_ms ? tick_ms : 1;
+#ifndef __AVR__
+    s->clock_ms = vt100_clock_ms();
+#endif
+}
+
+void vt100_sched_every(vt100_sched_t *s, vt100_timer_t *t, uint16_t period_ms, vt100_task_fn_t fn, void *ctx) {
+    t->fn = fn;
+    t->ctx = ctx;
+    t->period = (period_ms + s->tick_ms - 1) / s->tick_ms;
+    if (t->period == 0) t->period = 1;
+    vt100_sched_insert(s, t);
+}
+
+// fps == 0 renders on every run with dirty data
+void vt100_sched_render(vt100_sched_t *s, uint8_t fps, vt100_task_fn_t render, void *ctx) {
+    s->render = render;
+    s->render_ctx = ctx;
+    s->frame_ticks = fps ? (1000 / fps + s->tick_ms - 1) / s->tick_ms : 0;
+    s->dirty = true;
+}
+
+void vt100_sched_dirty(vt100_sched_t *s) {
+    s->dirty = true;
+}
+
+// Timer interrupt side, the only writer of s->ticks
+void vt100_sched_tick(vt100_sched_t *s) {
+    s->ticks++;
+}
+
+static void vt100_sched_advance(vt100_sched_t *s) {
+    vt100_timer_t **pp, *t, *due = NULL;
+    s->now++;
+    pp = &s->slot[s->now & WHEEL_MASK];
+    while ((t = *pp) != NULL) {
+        if (t->rounds) { t->rounds--; pp = &t->next; continue; }
+        *pp = t->next;
+        t->next = due;
+        due = t;
+    }
+    // Re-armed after the walk, a period of one wheel turn lands in this slot again
+    while ((t = due) != NULL) {
+        due = t->next;
+        vt100_sched_insert(s, t);
+        t->fn(t->ctx);
+    }
+}
+
+// Catches up on elapsed ticks, then renders if something changed and the
+// frame interval has passed. A render that marks dirty again put work off,
+// the line is busy; without a frame interval it is retried a tick later
+// rather than on the next run, which would spin.
+void vt100_sched_run(vt100_sched_t *s) {
+    uint8_t n = s->ticks - s->seen;
+    s->seen += n;
+    while (n--) vt100_sched_advance(s);
+    if (s->render && s->dirty && (int32_t)(s->now - s->next_frame) >= 0) {
+        s->dirty = false;
+        s->next_frame = s->now + s->frame_ticks;
+        s->frames++;
+        s->render(s->render_ctx);
+        if (s->dirty && s->frame_ticks == 0) s->next_frame = s->now + 1;
+    }
+}
+
+// How long the caller may sleep before vt100_sched_run has work, -1 forever.
+int32_t vt100_sched_idle_ms(vt100_sched_t *s) {
+    vt100_timer_t *t;
+    uint32_t d, best = UINT32_MAX;
+    if (s->render && s->dirty) {
+        best = ((int32_t)(s->next_frame - s->now) > 0) ? s->next_frame - s->now : 0;
+    }
+    for (d = 1; d <= VT100_WHEEL_SLOTS && d < best; d++) {
+        for (t = s->slot[(s->now + d) & WHEEL_MASK]; t; t = t->next) {
+            uint32_t due = d + (uint32_t)t->rounds * VT100_WHEEL_SLOTS;
+            if (due < best) best = due;
+        }
+    }
+    if (best == UINT32_MAX) return -1;
+    return best * s->tick_ms;
+}
+
+#ifndef __AVR__
+// Sleeps until fd is readable or the next timer or frame is due, then
+// advances the wheel by the time spent. There is no tick interrupt here,
+// so due timers already fire inside this call. True if fd has data.
+bool vt100_sched_wait(vt100_sched_t *s, int fd) {
+    struct pollfd p = { fd, POLLIN, 0 };
+    uint32_t now;
+    int r = poll(&p, 1, vt100_sched_idle_ms(s));
+    now = vt100_clock_ms();
+    while (now - s->clock_ms >= s->tick_ms) {
+        s->clock_ms += s->tick_ms;
+        vt100_sched_advance(s);
+    }
+    return r > 0 && (p.revents & POLLIN);
+}
+#endif
@@ -0,0 +1,71 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Hashed timer wheel for periodic tasks plus a frame-rate capped render
+// tick. On the MCU a timer interrupt calls vt100_sched_tick() and the main
+// loop vt100_sched_run(); on POSIX vt100_sched_wait() sleeps in poll() and
+// derives the ticks from CLOCK_MONOTONIC. The POSIX demo samples on a
+// thread of its own and only uses the render tick.
+
+#define VT100_WHEEL_SLOTS 16    // power of two
+
+typedef void (*vt100_task_fn_t)(void *ctx);
+
+typedef struct vt100_timer {
+    struct vt100_timer *next;
+    vt100_task_fn_t fn;
+    void     *ctx;
+    uint16_t period;    // in ticks
+    uint16_t rounds;    // wheel turns left before it fires
+} vt100_timer_t;
+
+typedef struct {
+    vt100_timer_t *slot[VT100_WHEEL_SLOTS];
+    uint32_t now;               // ticks processed by vt100_sched_run
+    volatile uint8_t ticks;     // written by vt100_sched_tick only
+    uint8_t  seen;
+    uint16_t tick_ms;
+    uint16_t frame_ticks;       // minimum distance between two renders
+    uint32_t next_frame;
+    bool     dirty;
+    vt100_task_fn_t render;
+    void     *render_ctx;
+    uint32_t frames;
+    uint32_t clock_ms;          // POSIX: time already turned into ticks
+} vt100_sched_t;
+
+void vt100_sched_init(vt100_sched_t *s, uint16_t tick_ms);
+void vt100_sched_every(vt100_sched_t *s, vt100_timer_t *t, uint16_t period_ms, vt100_task_fn_t fn, void *ctx);
+void vt100_sched_render(vt100_sched_t *s, uint8_t fps, vt100_task_fn_t render, void *ctx);
+void vt100_sched_dirty(vt100_sched_t *s);
+void vt100_sched_tick(vt100_sched_t *s);
+void vt100_sched_run(vt100_sched_t *s);
+int32_t vt100_sched_idle_ms(vt100_sched_t *s);
+#ifndef __AVR__
+bool vt100_sched_wait(vt100_sched_t *s, int fd);
+#endif
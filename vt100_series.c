@@ -0,0 +1,94 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "vt100_series.h"
+
+void vt100_series_init(vt100_series_t *s, uint16_t *v, uint8_t *minq, uint8_t *maxq, uint8_t size) {
+    s->v = v;
+    s->minq = minq;
+    s->maxq = maxq;
+    s->size = size;
+    s->count = 0;
+    s->head = 0;
+    s->min_f = 0; s->min_n = 0;
+    s->max_f = 0; s->max_n = 0;
+    s->sum = 0;
+    s->total = 0;
+    s->lo = 0;
+    s->hi = 0;
+}
+
+static uint8_t vt100_series_wrap(const vt100_series_t *s, uint16_t n) {
+    return (n >= s->size) ? n - s->size : n;
+}
+
+// Drops the oldest slot from a deque front, keeps rising (min) or falling
+// (max) order at the back and appends the new slot. Every slot enters and
+// leaves once, so this is amortised O(1).
+static void vt100_series_deque(vt100_series_t *s, uint8_t *q, uint8_t *f, uint8_t *n, uint16_t v, bool is_min) {
+    uint8_t back;
+    if (*n && q[*f] == s->head && s->count == s->size) {
+        *f = vt100_series_wrap(s, *f + 1);
+        (*n)--;
+    }
+    while (*n) {
+        back = q[vt100_series_wrap(s, *f + *n - 1)];
+        if (is_min ? s->v[back] < v : s->v[back] > v) break;
+        (*n)--;
+    }
+    q[vt100_series_wrap(s, *f + *n)] = s->head;
+    (*n)++;
+}
+
+void vt100_series_push(vt100_series_t *s, uint16_t v) {
+    vt100_series_deque(s, s->minq, &s->min_f, &s->min_n, v, true);
+    vt100_series_deque(s, s->maxq, &s->max_f, &s->max_n, v, false);
+    if (s->count == s->size) s->sum -= s->v[s->head];
+    else s->count++;
+    s->sum += v;
+    s->v[s->head] = v;
+    s->head = vt100_series_wrap(s, s->head + 1);
+    s->total++;
+}
+
+// age 0 is the newest sample, callers keep age below count.
+uint16_t vt100_series_at(const vt100_series_t *s, uint8_t age) {
+    return s->v[vt100_series_wrap(s, s->head + s->size - 1 - age)];
+}
+
+uint16_t vt100_series_last(const vt100_series_t *s) {
+    return s->count ? vt100_series_at(s, 0) : 0;
+}
+
+uint16_t vt100_series_min(const vt100_series_t *s) {
+    return s->min_n ? s->v[s->minq[s->min_f]] : 0;
+}
+
+uint16_t vt100_series_max(const vt100_series_t *s) {
+    return s->max_n ? s->v[s->maxq[s->max_f]] : 0;
+}
+
+uint16_t vt100_series_avg(const vt100_series_t *s) {
+    return s->count ? s->sum / s->count : 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Fixed-memory history of one channel: the last size samples in a ring,
+// plus two monotonic deques of ring slots so that the window minimum and
+// maximum, like the average, cost O(1) per sample.
+
+typedef struct {
+    uint16_t *v;        // samples, slot head is the next one written
+    uint8_t  *minq;     // slots with rising values, front is the minimum
+    uint8_t  *maxq;     // slots with falling values, front is the maximum
+    uint8_t  size;      // window length, all three arrays hold size entries
+    uint8_t  count;     // samples in the window
+    uint8_t  head;
+    uint8_t  min_f, min_n;  // deque front and length
+    uint8_t  max_f, max_n;
+    uint32_t sum;
+    uint32_t total;     // samples ever pushed, places them in sweep mode
+    uint16_t lo;        // scale of the widgets, lo == hi scales to min..max
+    uint16_t hi;
+} vt100_series_t;
+
+void vt100_series_init(vt100_series_t *s, uint16_t *v, uint8_t *minq, uint8_t *maxq, uint8_t size);
+void vt100_series_push(vt100_series_t *s, uint16_t v);
+uint16_t vt100_series_at(const vt100_series_t *s, uint8_t age);
+uint16_t vt100_series_last(const vt100_series_t *s);
+uint16_t vt100_series_min(const vt100_series_t *s);
+uint16_t vt100_series_max(const vt100_series_t *s);
+uint16_t vt100_series_avg(const vt100_series_t *s);
@@ -0,0 +1,62 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "vt100_snap.h"
+
+#define LOAD_ACQ(p)     __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE_REL(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+void vt100_snap_init(vt100_snap_t *s, void *data, uint16_t size) {
+    s->data = data;
+    s->size = size;
+    s->seq = 0;
+}
+
+// The data itself is copied plainly, the sequence around it tells the
+// reader whether its copy is whole.
+void vt100_snap_write(vt100_snap_t *s, const void *src) {
+    vt100_seq_t seq = s->seq;
+    __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(s->data, src, s->size);
+    STORE_REL(&s->seq, seq + 2);
+}
+
+// Copies the last published data into dst and returns its version.
+vt100_seq_t vt100_snap_read(vt100_snap_t *s, void *dst) {
+    vt100_seq_t a, b;
+    do {
+        while ((a = LOAD_ACQ(&s->seq)) & 1) ;
+        memcpy(dst, s->data, s->size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        b = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+    } while (a != b);
+    return a;
+}
+
+// Changes with every write, cheaper than a read to see if there is news.
+vt100_seq_t vt100_snap_version(vt100_snap_t *s) {
+    return LOAD_ACQ(&s->seq);
+}
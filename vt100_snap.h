@@ -0,0 +1,49 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+
+// Seqlock around one block of data. A single writer publishes, readers
+// copy without taking a lock and retry when a write overlapped the copy.
+// On POSIX the writer is a thread. On the MCU it is an interrupt handler
+// and the reader the main loop: the handler may interrupt a read, never
+// the other way round, so readers do not spin on a half-done write there.
+
+#ifdef __AVR__
+typedef uint8_t  vt100_seq_t;   // loads and stores of one byte are atomic
+#else
+typedef uint32_t vt100_seq_t;
+#endif
+
+typedef struct {
+    void        *data;
+    uint16_t    size;
+    vt100_seq_t seq;    // odd while a write is in progress
+} vt100_snap_t;
+
+void vt100_snap_init(vt100_snap_t *s, void *data, uint16_t size);
+void vt100_snap_write(vt100_snap_t *s, const void *src);
+vt100_seq_t vt100_snap_read(vt100_snap_t *s, void *dst);
+vt100_seq_t vt100_snap_version(vt100_snap_t *s);
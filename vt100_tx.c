@@ -0,0 +1,91 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "vt100_tx.h"
+
+void vt100_tx_init(vt100_tx_t *t, uint8_t *buf, vt100_idx_t size, vt100_tx_fn_t kick, vt100_tx_fn_t wait, void *ctx) {
+    vt100_ring_init(&t->ring, buf, size);
+    t->kick = kick;
+    t->wait = wait;
+    t->ctx = ctx;
+    t->min = (size >= 8) ? size / 8 : 1;
+    t->skipped = 0;
+    t->stalls = 0;
+    t->backlog_max = 0;
+}
+
+// As vt100_sink_t, ctx is the vt100_tx_t. Takes what fits, and if that is
+// not all of it kicks the transmitter and waits for more room.
+void vt100_tx_sink(void *ctx, const uint8_t *data, uint16_t len) {
+    vt100_tx_t *t = ctx;
+    vt100_idx_t n, room, pending;
+    while (len) {
+        room = vt100_ring_free(&t->ring);
+        n = (len < room) ? len : room;
+        if (n) {
+            vt100_ring_write(&t->ring, data, n);
+            data += n;
+            len -= n;
+            if (t->kick) t->kick(t->ctx);
+            pending = vt100_ring_count(&t->ring);
+            if (pending > t->backlog_max) t->backlog_max = pending;
+            continue;
+        }
+        t->stalls++;
+        if (t->wait) t->wait(t->ctx);
+    }
+}
+
+// Call before drawing a frame. False: skip it, the line is still busy
+// with earlier ones, and i->behind is set. True: draw it, the flush budget
+// is i->link or what the ring can take now, whichever is less. Output
+// still in the out buffer, such as a hardware scroll, goes ahead of it,
+// and so do the synchronized update brackets of vt100_frame_begin/end.
+bool vt100_tx_frame(vt100_tx_t *t, vt100_instance_t *i) {
+    vt100_idx_t room = vt100_ring_free(&t->ring), ahead = i->out.len;
+    if (i->caps & VT100_CAP_SYNC) ahead += VT100_SYNC_BYTES;
+    room = (room > ahead) ? room - ahead : 0;
+    if (room == 0 || room < t->min) {
+        t->skipped++;
+        i->behind = true;
+        return false;
+    }
+    i->budget = (i->link == 0 || room < i->link) ? room : i->link;
+    return true;
+}
+
+// Transmitter side, one byte for a TX interrupt. False once it is empty,
+// the interrupt disables itself then until the next kick.
+bool vt100_tx_get(vt100_tx_t *t, uint8_t *c) {
+    return vt100_ring_get(&t->ring, c);
+}
+
+vt100_idx_t vt100_tx_read(vt100_tx_t *t, uint8_t *data, vt100_idx_t len) {
+    return vt100_ring_read(&t->ring, data, len);
+}
+
+vt100_idx_t vt100_tx_pending(vt100_tx_t *t) {
+    return vt100_ring_count(&t->ring);
+}
@@ -0,0 +1,62 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022 Sergey Kostyanoy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "vt100_ring.h"
+#include "vt100_print.h"
+
+// Transmit queue between vt100_out and a UART that sends on its own.
+// vt100_tx_sink only copies into a ring and kicks the transmitter, which
+// empties the ring from its interrupt with vt100_tx_get, or by DMA or a
+// writer thread with vt100_tx_read. Before a frame vt100_tx_frame checks
+// the room left: with too little the frame is skipped, otherwise the
+// shadow flush is held to what fits. Either way the next diff covers what
+// did not go out, and the main loop never waits on the line. Only output
+// that does not fit at all waits, counted in stalls.
+//
+// The ring size is a power of two that vt100_idx_t holds, at most 128
+// bytes on AVR. A frame is only started with an eighth of it free.
+
+typedef void (*vt100_tx_fn_t)(void *ctx);
+
+typedef struct {
+    vt100_ring_t ring;
+    vt100_tx_fn_t kick;     // data is waiting: enable the TX interrupt, wake the writer
+    vt100_tx_fn_t wait;     // the ring is full: sleep until it took some, NULL spins
+    void *ctx;
+    vt100_idx_t min;        // least room a frame is started with
+    uint32_t skipped;       // frames that found too little room
+    uint32_t stalls;        // sink calls that had to wait
+    vt100_idx_t backlog_max;
+} vt100_tx_t;
+
+void vt100_tx_init(vt100_tx_t *t, uint8_t *buf, vt100_idx_t size, vt100_tx_fn_t kick, vt100_tx_fn_t wait, void *ctx);
+void vt100_tx_sink(void *ctx, const uint8_t *data, uint16_t len);
+bool vt100_tx_frame(vt100_tx_t *t, vt100_instance_t *i);
+bool vt100_tx_get(vt100_tx_t *t, uint8_t *c);
+vt100_idx_t vt100_tx_read(vt100_tx_t *t, uint8_t *data, vt100_idx_t len);
+vt100_idx_t vt100_tx_pending(vt100_tx_t *t);